@@ -1,5 +1,4 @@
 #include <pthread.h>
-#include <ncursesw/ncurses.h>
 #include <stdlib.h>
 #include "common.h"
 #include "beast.h"
@@ -8,16 +7,16 @@
 #include "map.h"
 #include "tiles.h"
 
-// Inicjuje bestie
-void beast_init(struct beast_t *beast, int x, int y)
+// Inicjuje bestie - kierunek losowany z podanego generatora
+void beast_init(struct beast_t *beast, int x, int y, struct rng_t *rng)
 {
     beast->x = x;
     beast->y = y;
-    beast->current_direction = (enum action_t)(rand()%4);
+    beast->current_direction = (enum action_t)rng_below(rng, 4);
     beast->turns_to_wait = 0;
 }
 
-// Sprawdza czy bestia widzi jakiegoś gracza
+// Sprawdza czy bestia widzi jakiegoś gracza - okno 5x5 wokół bestii mieści się w ramce mapy
 int beast_see_player(struct beast_t *beast, struct map_t *map)
 {
     int x = beast->x;
@@ -27,7 +26,7 @@ int beast_see_player(struct beast_t *beast, struct map_t *map)
     {
         for(int j=-1; j<=1; j++)
         {
-            tile_t tile = map_get_tile(map, x+i, y+j);
+            tile_t tile = map_tile_at(map, x+i, y+j);
             if(tile_is_player(tile)) return 1;
         }
     }
@@ -36,25 +35,25 @@ int beast_see_player(struct beast_t *beast, struct map_t *map)
     {
         for(int ax=-1; ax<=1; ax+=2)
         {
-            if(tile_is_player(map_get_tile(map, x+2*ax, y+2*ay)) &&
-            map_get_tile(map, x+1*ax, y+1*ay)!=TILE_WALL) 
+            if(tile_is_player(map_tile_at(map, x+2*ax, y+2*ay)) &&
+            map_tile_at(map, x+1*ax, y+1*ay)!=TILE_WALL) 
                 return 1;
             
 
-            if(tile_is_player(map_get_tile(map, x+2*ax, y)) &&
-            map_get_tile(map, x+1*ax, y)!=TILE_WALL) 
+            if(tile_is_player(map_tile_at(map, x+2*ax, y)) &&
+            map_tile_at(map, x+1*ax, y)!=TILE_WALL) 
                 return 1;
 
-            if(tile_is_player(map_get_tile(map, x, y+2*ay)) &&
-            map_get_tile(map, x, y+1*ay)!=TILE_WALL) 
+            if(tile_is_player(map_tile_at(map, x, y+2*ay)) &&
+            map_tile_at(map, x, y+1*ay)!=TILE_WALL) 
                 return 1;
 
-            if(tile_is_player(map_get_tile(map, x+2*ax, y+1*ay)) &&
-            map_get_tile(map, x+1*ax, y+1*ay)!=TILE_WALL && map_get_tile(map, x+1*ax, y)!=TILE_WALL) 
+            if(tile_is_player(map_tile_at(map, x+2*ax, y+1*ay)) &&
+            map_tile_at(map, x+1*ax, y+1*ay)!=TILE_WALL && map_tile_at(map, x+1*ax, y)!=TILE_WALL) 
                 return 1;
 
-            if(tile_is_player(map_get_tile(map, x+1*ax, y+2*ay)) &&
-            map_get_tile(map, x+1*ax, y+1*ay)!=TILE_WALL && map_get_tile(map, x, y+1*ay)!=TILE_WALL) 
+            if(tile_is_player(map_tile_at(map, x+1*ax, y+2*ay)) &&
+            map_tile_at(map, x+1*ax, y+1*ay)!=TILE_WALL && map_tile_at(map, x, y+1*ay)!=TILE_WALL) 
                 return 1;
         }
     }
@@ -62,36 +61,30 @@ int beast_see_player(struct beast_t *beast, struct map_t *map)
     return 0;
 }
 
-// Zwraca kierunek do atakowania gracza
-enum action_t beast_attack_player(struct beast_t *beast, struct map_t *map)
+// Podjęcie decyzji bestii na podstawie pełnej mapy i pola odległości od graczy - tylko odczyt danych serwera
+// Pole odległości musi być aktualne, a wszystkie losowania pochodzą z random, więc decyzja może być podejmowana w dowolnym wątku
+void beast_decide(struct server_data_t *sd, struct beast_t *beast, unsigned random, struct beast_decision_t *decision)
 {
-    enum tile_t possible_targets[4] = { TILE_PLAYER1, TILE_PLAYER2, TILE_PLAYER3, TILE_PLAYER4 };
-    for(int i=0; i<4; i++)
-    {
-        enum action_t target_direction = indep_navigate_tile(map, beast->x, beast->y, possible_targets[i], 3);
-        if(target_direction!=ACTION_VOID) return target_direction;
-    }
-    return ACTION_VOID;
-}
-
-// Aktualizacja bestii
-void beast_update(struct server_data_t *sd, int nr)
-{
-    struct beast_t *beast = &sd->beasts.at(nr);
-    struct map_t complete_map;
-    sd_create_complete_map(sd, &complete_map);
+    struct map_t *complete_map = &sd->complete_map;
 
-    // Atakuje gracza jeśli go widzi
-    if(beast_see_player(beast, &complete_map))
+    // Atakuje gracza jeśli go widzi - zejście po wspólnym polu odległości od graczy
+    if(beast_see_player(beast, complete_map))
     {
-        enum action_t direction = beast_attack_player(beast, &complete_map);
-        sd_move_beast(sd, beast, direction);
+        decision->direction = indep_distance_field_step(&sd->players_field, beast->x, beast->y, BEAST_ATTACK_DISTANCE, random);
+        decision->attack = 1;
+        decision->field_version = sd->players_field_version;
         return;
     }
 
     // Podąża lewą świaną
-    enum action_t direction = indep_follow_left_wall(&complete_map, beast->x, beast->y, beast->current_direction);
-    if(beast->turns_to_wait==0) beast->current_direction = direction;
-    sd_move_beast(sd, beast, direction);
-    return;
-}
\ No newline at end of file
+    decision->direction = indep_follow_left_wall(complete_map, beast->x, beast->y, beast->current_direction);
+    decision->attack = 0;
+}
+
+// Wykonanie ruchu wybranego w beast_decide
+void beast_apply(struct server_data_t *sd, struct beast_t *beast, struct beast_decision_t *decision)
+{
+    if(!decision->attack && beast->turns_to_wait==0)
+        beast->current_direction = decision->direction;
+    sd_move_beast(sd, beast, decision->direction);
+}
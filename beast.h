@@ -3,6 +3,10 @@
 
 #include <pthread.h>
 #include "common.h"
+#include "rng.h"
+
+// Maksymalna długość drogi, jaką bestia pokona goniąc gracza
+#define BEAST_ATTACK_DISTANCE 3
 
 // Dane bestii
 struct beast_t
@@ -15,9 +19,20 @@ struct beast_t
     int turns_to_stay;
 };
 
+// Decyzja bestii - podejmowana osobno od wykonania ruchu, by decyzje wielu bestii mogły być podejmowane równolegle
+struct beast_decision_t
+{
+    enum action_t direction;
+
+    // Czy bestia atakuje i na podstawie której wersji pola odległości od graczy wybrała kierunek
+    int attack;
+    unsigned field_version;
+};
+
 // Prototypy
-void beast_init(struct beast_t *beast, int x, int y);
-void beast_update(struct server_data_t *sd, int nr);
+void beast_init(struct beast_t *beast, int x, int y, struct rng_t *rng);
+void beast_decide(struct server_data_t *sd, struct beast_t *beast, unsigned random, struct beast_decision_t *decision);
+void beast_apply(struct server_data_t *sd, struct beast_t *beast, struct beast_decision_t *decision);
 int beast_see_player(struct beast_t *beast, struct map_t *map);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,522 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "common.h"
+#include "map.h"
+#include "pool.h"
+#include "rng.h"
+#include "beast.h"
+#include "independant.h"
+#include "server_data.h"
+#include "tiles.h"
+
+// Domyślna liczba powtórzeń tanich pomiarów - droższe pomiary wykonywane są proporcjonalnie rzadziej
+#define BENCH_ITERATIONS 20000
+#define BENCH_SEED 1
+
+// Domyślne rozmiary map i największa liczba rozmiarów podanych przez -m
+#define BENCH_MAX_SIZES 16
+static const int bench_default_sizes[] = { 63, 255, 1023 };
+
+// Generowanie i przebudowa mapy - liczba powtórzeń tak dobrana, by na każdym rozmiarze przejść około tylu kafelków
+#define BENCH_MAP_WORK 16000000
+#define BENCH_MAP_MAX_REPEATS 50
+
+// Liczby graczy i mnożniki liczby bestii względem generowanej przy starcie rundy
+static const int bench_players[] = { 1, 16, 256 };
+static const int bench_beast_multipliers[] = { 1, 4 };
+
+// Gracze obecni w czasie ruchu bestii
+#define BENCH_BEAST_PLAYERS 16
+
+// Zasięgi przeszukiwań - od szukania monet w pobliżu przez bota po drogę do obozu przez pół mapy
+static const int bench_navigate_distances[] = { 4, 16, 64 };
+#define BENCH_FIELD_SOURCES 64
+#define BENCH_FIELD_DISTANCE 32
+
+#ifdef MAP_LAYOUT_TILED
+#define BENCH_LAYOUT "tiled"
+#else
+#define BENCH_LAYOUT "row-major"
+#endif
+
+#define BENCH_ARRAY_SIZE(__array) ((int)(sizeof(__array)/sizeof((__array)[0])))
+
+// Parametr pomiaru - nazwa i wartość, wypisywane razem z wynikiem
+struct bench_param_t
+{
+    const char *name;
+    long long value;
+};
+
+// Ustawienia całego zestawu
+struct bench_options_t
+{
+    int iterations;
+    uint64_t seed;
+    int threads;
+    int json;
+    const char *filter;
+};
+
+// Funkcje statyczne
+static long long bench_now_ns(void);
+static int bench_selected(const char *name);
+static void bench_report(const char *name, int width, int height, const struct bench_param_t *params, int params_count,
+    long long elapsed_ns, long long operations, unsigned long long checksum);
+static void bench_prepare_round(int width, int height, int capacity);
+static void bench_random_positions(int count, std::vector<int> *xs, std::vector<int> *ys);
+static int bench_map_repeats(int width, int height);
+static void bench_generate_everything(int width, int height);
+static void bench_random_free_position(int width, int height);
+static void bench_rebuild_complete_map(int width, int height);
+static void bench_move(int width, int height);
+static void bench_update_beasts(int width, int height);
+static void bench_navigate_tile(int width, int height);
+static void bench_distance_field(int width, int height);
+static void bench_surrounding_area(int width, int height);
+static void bench_beast_see_player(int width, int height);
+static void bench_client_map(int width, int height);
+static unsigned long long bench_map_checksum(struct map_t *map);
+
+// Ustawienia, dane serwera z wygenerowaną rundą i pula wątków dla ruchu bestii
+static struct bench_options_t options;
+static struct server_data_t bench_data;
+static struct worker_pool_t bench_pool;
+
+// Aktualny czas w nanosekundach
+static long long bench_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec*1000000000LL+now.tv_nsec;
+}
+
+// Czy pomiar o danej nazwie ma zostać wykonany - filtr -b wybiera pomiary zawierające podany tekst
+static int bench_selected(const char *name)
+{
+    return options.filter==NULL || strstr(name, options.filter)!=NULL;
+}
+
+// Wypisanie wyniku pomiaru - w formacie dla ludzi lub jako jeden obiekt JSON w wierszu
+// Suma kontrolna zależy tylko od ziarna i rozmiaru mapy, więc pozwala sprawdzić, że oba układy mapy i kolejne wersje liczą to samo
+static void bench_report(const char *name, int width, int height, const struct bench_param_t *params, int params_count,
+    long long elapsed_ns, long long operations, unsigned long long checksum)
+{
+    double ns_per_op = (double)elapsed_ns/operations;
+
+    if(options.json)
+    {
+        printf("{\"benchmark\":\"%s\",\"width\":%d,\"height\":%d,\"layout\":\"%s\",\"seed\":%llu", name, width, height, BENCH_LAYOUT,
+            (unsigned long long)options.seed);
+        for(int i=0; i<params_count; i++)
+            printf(",\"%s\":%lld", params[i].name, params[i].value);
+        printf(",\"operations\":%lld,\"ns_per_op\":%.1f,\"checksum\":%llu}\n", operations, ns_per_op, checksum);
+    }
+    else
+    {
+        char size[32];
+        char text[128];
+        int length = 0;
+        text[0] = 0;
+        snprintf(size, sizeof(size), "%dx%d", width, height);
+        for(int i=0; i<params_count && length<(int)sizeof(text); i++)
+            length += snprintf(text+length, sizeof(text)-length, "%s%s=%lld", i>0 ? " " : "", params[i].name, params[i].value);
+        printf("%-32s %-9s %-9s %-30s %12.1f ns/op %9lld ops  checksum=%llu\n", name, size, BENCH_LAYOUT, text, ns_per_op, operations, checksum);
+    }
+    fflush(stdout);
+}
+
+// Wygenerowanie rundy bez wątku w tle - pomiary nie dzielą procesora z generowaniem kolejnej rundy
+static void bench_prepare_round(int width, int height, int capacity)
+{
+    sd_init(&bench_data, capacity, width, height, options.seed);
+    sd_generate_round(&bench_data);
+    bench_data.pool = options.threads>1 ? &bench_pool : NULL;
+}
+
+// Losowe pozycje na wolnych kafelkach bieżącej rundy - zawsze te same dla danego ziarna
+static void bench_random_positions(int count, std::vector<int> *xs, std::vector<int> *ys)
+{
+    struct rng_t rng;
+    rng_seed_stream(&rng, options.seed, RNG_STREAM_ENTITIES);
+    xs->resize(count);
+    ys->resize(count);
+    for(int i=0; i<count; i++)
+        map_random_free_position(&bench_data.free_cells, &rng, &(*xs)[i], &(*ys)[i]);
+}
+
+// Liczba powtórzeń pomiarów przechodzących całą mapę
+static int bench_map_repeats(int width, int height)
+{
+    int repeats = BENCH_MAP_WORK/(width*height);
+    if(repeats<1)
+        repeats = 1;
+    if(repeats>BENCH_MAP_MAX_REPEATS)
+        repeats = BENCH_MAP_MAX_REPEATS;
+    return repeats;
+}
+
+// Generowanie mapy rundy - labirynt, dziury, obóz i krzaki
+static void bench_generate_everything(int width, int height)
+{
+    struct map_t map;
+    map_init(&map, width, height);
+    struct rng_t rng;
+    rng_seed_stream(&rng, options.seed, RNG_STREAM_MAZE);
+
+    int repeats = bench_map_repeats(width, height);
+    unsigned long long checksum = 0;
+    long long start = bench_now_ns();
+    for(int r=0; r<repeats; r++)
+    {
+        map_generate_everything(&map, &rng);
+        checksum += map.campside_y*width+map.campside_x;
+    }
+    bench_report("map_generate_everything", width, height, NULL, 0, bench_now_ns()-start, repeats, checksum);
+}
+
+// Losowanie wolnej pozycji - przy spawnie gracza, dokładaniu monet i bestii
+static void bench_random_free_position(int width, int height)
+{
+    bench_prepare_round(width, height, 1);
+    struct rng_t rng;
+    rng_seed_stream(&rng, options.seed, RNG_STREAM_ENTITIES);
+
+    unsigned long long checksum = 0;
+    long long start = bench_now_ns();
+    for(int i=0; i<options.iterations; i++)
+    {
+        int x = 0;
+        int y = 0;
+        map_random_free_position(&bench_data.free_cells, &rng, &x, &y);
+        checksum += y*width+x;
+    }
+    bench_report("map_random_free_position", width, height, NULL, 0, bench_now_ns()-start, options.iterations, checksum);
+}
+
+// Przebudowa całej pełnej mapy - wykonywana przy generowaniu rundy
+static void bench_rebuild_complete_map(int width, int height)
+{
+    bench_prepare_round(width, height, 1);
+
+    int repeats = bench_map_repeats(width, height);
+    unsigned long long checksum = 0;
+    long long start = bench_now_ns();
+    for(int r=0; r<repeats; r++)
+    {
+        sd_rebuild_complete_map(&bench_data);
+        checksum += bench_data.free_cells.cells.size();
+    }
+    bench_report("sd_rebuild_complete_map", width, height, NULL, 0, bench_now_ns()-start, repeats, checksum);
+}
+
+// Ruchy graczy przy różnej liczbie graczy i bestii - zbieranie monet, śmierci, krzaki
+static void bench_move(int width, int height)
+{
+    for(int p=0; p<BENCH_ARRAY_SIZE(bench_players); p++)
+    {
+        for(int m=0; m<BENCH_ARRAY_SIZE(bench_beast_multipliers); m++)
+        {
+            int players = bench_players[p];
+            bench_prepare_round(width, height, players);
+            int generated = bench_data.beasts.size();
+            for(int i=generated; i<generated*bench_beast_multipliers[m]; i++)
+                sd_add_beast(&bench_data);
+            for(int i=0; i<players; i++)
+                sd_add_client(&bench_data, i, 1000+i, CLIENT_TYPE_CPU);
+
+            // Akcje wylosowane przed pomiarem - w każdej turze po jednej akcji każdego gracza
+            int turns = (options.iterations+players-1)/players;
+            struct rng_t rng;
+            rng_seed_stream(&rng, options.seed, RNG_STREAM_BOT);
+            std::vector<uint8_t> actions(turns*players);
+            for(int i=0; i<(int)actions.size(); i++)
+                actions[i] = rng_below(&rng, 5);
+
+            long long start = bench_now_ns();
+            for(int t=0; t<turns; t++)
+            {
+                for(int i=0; i<players; i++)
+                    sd_move(&bench_data, i, (enum action_t)actions[t*players+i]);
+            }
+            long long elapsed = bench_now_ns()-start;
+
+            struct bench_param_t params[] = { { "players", players }, { "beasts", (long long)bench_data.beasts.size() } };
+            bench_report("sd_move", width, height, params, 2, elapsed, (long long)turns*players, sd_state_hash(&bench_data));
+        }
+    }
+}
+
+// Ruch wszystkich bestii w turze - przy różnej liczbie bestii
+static void bench_update_beasts(int width, int height)
+{
+    int ticks = options.iterations/100;
+    if(ticks<10)
+        ticks = 10;
+
+    for(int m=0; m<BENCH_ARRAY_SIZE(bench_beast_multipliers); m++)
+    {
+        bench_prepare_round(width, height, BENCH_BEAST_PLAYERS);
+        int generated = bench_data.beasts.size();
+        for(int i=generated; i<generated*bench_beast_multipliers[m]; i++)
+            sd_add_beast(&bench_data);
+        for(int i=0; i<BENCH_BEAST_PLAYERS; i++)
+            sd_add_client(&bench_data, i, 1000+i, CLIENT_TYPE_CPU);
+        int beasts = bench_data.beasts.size();
+
+        long long start = bench_now_ns();
+        for(int t=0; t<ticks; t++)
+        {
+            bench_data.tick++;
+            sd_update_beasts(&bench_data);
+        }
+        long long elapsed = bench_now_ns()-start;
+
+        struct bench_param_t params[] = { { "beasts", beasts }, { "players", BENCH_BEAST_PLAYERS }, { "threads", options.threads } };
+        bench_report("sd_update_beasts", width, height, params, 3, elapsed, ticks, sd_state_hash(&bench_data));
+    }
+}
+
+// Szukanie drogi do najbliższej monety na różnych odległościach - jak robi to bot
+static void bench_navigate_tile(int width, int height)
+{
+    bench_prepare_round(width, height, 1);
+    std::vector<int> xs;
+    std::vector<int> ys;
+    bench_random_positions(options.iterations, &xs, &ys);
+
+    for(int d=0; d<BENCH_ARRAY_SIZE(bench_navigate_distances); d++)
+    {
+        struct rng_t rng;
+        rng_seed_stream(&rng, options.seed, RNG_STREAM_BOT);
+
+        // Dłuższe przeszukiwania wykonywane rzadziej - bufory robocze przygotowane przed pomiarem
+        int distance = bench_navigate_distances[d];
+        int count = options.iterations*4/distance+1;
+        if(count>options.iterations)
+            count = options.iterations;
+        indep_navigate_tile(&bench_data.complete_map, xs[0], ys[0], TILE_COIN, distance, &rng);
+
+        unsigned long long checksum = 0;
+        long long start = bench_now_ns();
+        for(int i=0; i<count; i++)
+            checksum += indep_navigate_tile(&bench_data.complete_map, xs[i], ys[i], TILE_COIN, distance, &rng);
+        long long elapsed = bench_now_ns()-start;
+
+        struct bench_param_t params[] = { { "distance", distance } };
+        bench_report("indep_navigate_tile", width, height, params, 1, elapsed, count, checksum);
+    }
+}
+
+// Pole odległości od wielu źródeł - jak przy szukaniu graczy przez bestie
+static void bench_distance_field(int width, int height)
+{
+    bench_prepare_round(width, height, 1);
+    std::vector<int> xs;
+    std::vector<int> ys;
+    bench_random_positions(options.iterations, &xs, &ys);
+
+    struct indep_distance_field_t field = {};
+    indep_distance_field_build(&field, &bench_data.complete_map, xs.data(), ys.data(), 1, BENCH_FIELD_DISTANCE);
+    int builds = options.iterations/BENCH_FIELD_SOURCES;
+    if(builds==0)
+        builds = 1;
+
+    unsigned long long checksum = 0;
+    long long start = bench_now_ns();
+    for(int b=0; b<builds; b++)
+    {
+        int first = b*BENCH_FIELD_SOURCES;
+        int count = options.iterations-first<BENCH_FIELD_SOURCES ? options.iterations-first : BENCH_FIELD_SOURCES;
+        indep_distance_field_build(&field, &bench_data.complete_map, &xs[first], &ys[first], count, BENCH_FIELD_DISTANCE);
+        checksum += indep_distance_field_get(&field, xs[first]+1, ys[first])+1;
+    }
+    long long elapsed = bench_now_ns()-start;
+
+    struct bench_param_t params[] = { { "sources", BENCH_FIELD_SOURCES }, { "distance", BENCH_FIELD_DISTANCE } };
+    bench_report("indep_distance_field_build", width, height, params, 2, elapsed, builds, checksum);
+}
+
+// Wycinanie otoczenia gracza z pełnej mapy - dla każdego klienta w każdej turze
+static void bench_surrounding_area(int width, int height)
+{
+    bench_prepare_round(width, height, 1);
+    std::vector<int> xs;
+    std::vector<int> ys;
+    bench_random_positions(options.iterations, &xs, &ys);
+
+    unsigned long long checksum = 0;
+    long long start = bench_now_ns();
+    for(int i=0; i<options.iterations; i++)
+    {
+        surrounding_area_t area;
+        sd_fill_surrounding_area(&bench_data.complete_map, xs[i], ys[i], &area);
+        checksum += area[0][0]+area[VISIBLE_AREA_SIZE-1][VISIBLE_AREA_SIZE-1];
+    }
+    bench_report("sd_fill_surrounding_area", width, height, NULL, 0, bench_now_ns()-start, options.iterations, checksum);
+}
+
+// Sprawdzanie czy bestia widzi gracza - z graczami rozstawionymi jak w czasie ruchu bestii
+static void bench_beast_see_player(int width, int height)
+{
+    bench_prepare_round(width, height, BENCH_BEAST_PLAYERS);
+    for(int i=0; i<BENCH_BEAST_PLAYERS; i++)
+        sd_add_client(&bench_data, i, 1000+i, CLIENT_TYPE_CPU);
+    std::vector<int> xs;
+    std::vector<int> ys;
+    bench_random_positions(options.iterations, &xs, &ys);
+
+    unsigned long long checksum = 0;
+    long long start = bench_now_ns();
+    for(int i=0; i<options.iterations; i++)
+    {
+        struct beast_t beast;
+        beast.x = xs[i];
+        beast.y = ys[i];
+        checksum += beast_see_player(&beast, &bench_data.complete_map);
+    }
+    bench_report("beast_see_player", width, height, NULL, 0, bench_now_ns()-start, options.iterations, checksum);
+}
+
+// Suma kontrolna wszystkich kafelków mapy
+static unsigned long long bench_map_checksum(struct map_t *map)
+{
+    unsigned long long checksum = 0;
+    for(int y=0; y<map->height; y++)
+    {
+        for(int x=0; x<map->width; x++)
+            checksum = checksum*31+map_get_tile(map, x, y);
+    }
+    return checksum;
+}
+
+// Mapa widziana przez klienta - nanoszenie otoczenia z serwera i usuwanie niepewnych kafelków z poprzedniej pozycji
+static void bench_client_map(int width, int height)
+{
+    bench_prepare_round(width, height, 1);
+    std::vector<int> xs;
+    std::vector<int> ys;
+    bench_random_positions(options.iterations, &xs, &ys);
+
+    // Otoczenia przygotowane przed pomiarem, tak jak przychodzą od serwera
+    std::vector<surrounding_area_t> areas(options.iterations);
+    for(int i=0; i<options.iterations; i++)
+        sd_fill_surrounding_area(&bench_data.complete_map, xs[i], ys[i], &areas[i]);
+
+    struct map_t client_map;
+    map_init(&client_map, width, height);
+    map_fill(&client_map, TILE_UNKNOWN);
+
+    long long start = bench_now_ns();
+    for(int i=0; i<options.iterations; i++)
+        map_update_with_surrounding_area(&client_map, &areas[i], xs[i], ys[i]);
+    long long elapsed = bench_now_ns()-start;
+
+    if(bench_selected("map_update_with_surrounding_area"))
+        bench_report("map_update_with_surrounding_area", width, height, NULL, 0, elapsed, options.iterations, bench_map_checksum(&client_map));
+
+    start = bench_now_ns();
+    for(int i=0; i<options.iterations; i++)
+        map_remove_unsure_tiles(&client_map, xs[i], ys[i]);
+    elapsed = bench_now_ns()-start;
+
+    if(bench_selected("map_remove_unsure_tiles"))
+        bench_report("map_remove_unsure_tiles", width, height, NULL, 0, elapsed, options.iterations, bench_map_checksum(&client_map));
+}
+
+// Zestaw pomiarów najczęstszych operacji rdzenia gry na kilku rozmiarach map i przy różnej liczbie graczy i bestii
+int main(int argc, char **argv)
+{
+    options.iterations = BENCH_ITERATIONS;
+    options.seed = BENCH_SEED;
+    options.threads = 1;
+    options.json = 0;
+    options.filter = NULL;
+
+    int widths[BENCH_MAX_SIZES];
+    int heights[BENCH_MAX_SIZES];
+    int sizes_count = 0;
+
+    int opt;
+    while((opt = getopt(argc, argv, "m:n:s:j:b:J")) != -1)
+    {
+        int width = 0;
+        int height = 0;
+        unsigned long long seed = 0;
+        if(opt=='m' && sizes_count<BENCH_MAX_SIZES && sscanf(optarg, "%dx%d", &width, &height)==2 && width%2==1 && height%2==1
+            && width>=MAP_MIN_SIZE && height>=MAP_MIN_SIZE && width<=MAP_MAX_SIZE && height<=MAP_MAX_SIZE)
+        {
+            widths[sizes_count] = width;
+            heights[sizes_count] = height;
+            sizes_count++;
+        }
+        else if(opt=='n' && atoi(optarg)>0)
+            options.iterations = atoi(optarg);
+        else if(opt=='s' && sscanf(optarg, "%llu", &seed)==1)
+            options.seed = seed;
+        else if(opt=='j' && atoi(optarg)>0)
+            options.threads = atoi(optarg);
+        else if(opt=='b')
+            options.filter = optarg;
+        else if(opt=='J')
+            options.json = 1;
+        else
+        {
+            fprintf(stderr, "Usage: %s [-m WIDTHxHEIGHT]... [-n iterations] [-s seed] [-j threads] [-b name] [-J]\n"
+                "  -m  map size, may be repeated (default 63x63, 255x255 and 1023x1023)\n"
+                "  -n  iterations of the cheap benchmarks (default %d), expensive ones scale down from it\n"
+                "  -s  seed of the generated rounds and inputs (default %d)\n"
+                "  -j  threads deciding beast moves (default 1)\n"
+                "  -b  run only benchmarks whose name contains this text\n"
+                "  -J  print one JSON object per line instead of a table\n", argv[0], BENCH_ITERATIONS, BENCH_SEED);
+            return 1;
+        }
+    }
+
+    if(sizes_count==0)
+    {
+        for(int i=0; i<BENCH_ARRAY_SIZE(bench_default_sizes); i++)
+        {
+            widths[sizes_count] = bench_default_sizes[i];
+            heights[sizes_count] = bench_default_sizes[i];
+            sizes_count++;
+        }
+    }
+
+    if(options.threads>1)
+        pool_init(&bench_pool, options.threads);
+
+    for(int s=0; s<sizes_count; s++)
+    {
+        int width = widths[s];
+        int height = heights[s];
+
+        if(bench_selected("map_generate_everything"))
+            bench_generate_everything(width, height);
+        if(bench_selected("map_random_free_position"))
+            bench_random_free_position(width, height);
+        if(bench_selected("sd_rebuild_complete_map"))
+            bench_rebuild_complete_map(width, height);
+        if(bench_selected("sd_move"))
+            bench_move(width, height);
+        if(bench_selected("sd_update_beasts"))
+            bench_update_beasts(width, height);
+        if(bench_selected("indep_navigate_tile"))
+            bench_navigate_tile(width, height);
+        if(bench_selected("indep_distance_field_build"))
+            bench_distance_field(width, height);
+        if(bench_selected("sd_fill_surrounding_area"))
+            bench_surrounding_area(width, height);
+        if(bench_selected("beast_see_player"))
+            bench_beast_see_player(width, height);
+        if(bench_selected("map_update_with_surrounding_area") || bench_selected("map_remove_unsure_tiles"))
+            bench_client_map(width, height);
+    }
+
+    return 0;
+}
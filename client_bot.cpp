@@ -3,11 +3,15 @@
 #include <stdlib.h>
 #include <ncursesw/ncurses.h>
 #include <ctype.h>
+#include <time.h>
+#include <unistd.h>
 #include "client_common.h"
 #include "common.h"
+#include "display.h"
 #include "client_data.h"
 #include "map.h"
 #include "independant.h"
+#include "rng.h"
 #include "tiles.h"
 
 // Ile monet musi zebrać bot aby postanowić wrócić do bazy
@@ -30,6 +34,9 @@ enum action_t current_direction;
 int last_x;
 int last_y;
 
+// Generator wyboru drogi ucieczki i drogi spośród równie krótkich
+struct rng_t bot_rng;
+
 // Wątek obsługujący klawiature
 static void *clientb_input_thread(void *ptr)
 {
@@ -67,7 +74,7 @@ static action_t clientb_escape(enum action_t beast_dir, struct map_t *map, int x
     if(good_ways==0)
         return ACTION_DO_NOTHING;
 
-    int way = rand()%good_ways;
+    int way = rng_below(&bot_rng, good_ways);
 
     for(int i=0; i<4; i++)
     {
@@ -85,7 +92,7 @@ static action_t clientb_escape(enum action_t beast_dir, struct map_t *map, int x
 // Zachowanie bota
 static void clientb_behaviour(void)
 {
-    struct map_t map = clientc_get_map();
+    struct map_t *map = clientc_get_map();
 
     int x=0;
     int y=0;
@@ -94,10 +101,10 @@ static void clientb_behaviour(void)
     enum action_t direction;
 
     // Ucieczka przed bestią
-    direction = indep_navigate_tile(&map, x, y, TILE_BEAST, 4);
+    direction = indep_navigate_tile(map, x, y, TILE_BEAST, 4, &bot_rng);
     if(direction!=ACTION_VOID)
     {
-        enum action_t escape_direction = clientb_escape(direction, &map, x, y);
+        enum action_t escape_direction = clientb_escape(direction, map, x, y);
         clientc_move(escape_direction);
         current_direction = escape_direction;
         return;
@@ -106,7 +113,7 @@ static void clientb_behaviour(void)
     // Powrót do obozu
     if(clientc_is_campside_known() && clientc_get_found_money()>MONEY_TO_RETURN)
     {
-        direction = indep_navigate_tile(&map, x, y, TILE_CAMPSIDE, MAP_HEIGHT);
+        direction = indep_navigate_tile(map, x, y, TILE_CAMPSIDE, map->height, &bot_rng);
         if(direction!=ACTION_VOID)
         {
             clientc_move(direction);
@@ -116,7 +123,7 @@ static void clientb_behaviour(void)
     }
 
     // Zbieraj dropy
-    direction = indep_navigate_tile(&map, x, y, TILE_DROP, 4);
+    direction = indep_navigate_tile(map, x, y, TILE_DROP, 4, &bot_rng);
     if(direction!=ACTION_VOID)
     {
         clientc_move(direction);
@@ -125,7 +132,7 @@ static void clientb_behaviour(void)
     }
 
     // Zbieraj duże skarby
-    direction = indep_navigate_tile(&map, x, y, TILE_L_TREASURE, 4);
+    direction = indep_navigate_tile(map, x, y, TILE_L_TREASURE, 4, &bot_rng);
     if(direction!=ACTION_VOID)
     {
         clientc_move(direction);
@@ -134,7 +141,7 @@ static void clientb_behaviour(void)
     }
 
     // Zbieraj małe skarby
-    direction = indep_navigate_tile(&map, x, y, TILE_S_TREASURE, 4);
+    direction = indep_navigate_tile(map, x, y, TILE_S_TREASURE, 4, &bot_rng);
     if(direction!=ACTION_VOID)
     {
         clientc_move(direction);
@@ -143,7 +150,7 @@ static void clientb_behaviour(void)
     }
 
     // Zbieraj monety
-    direction = indep_navigate_tile(&map, x, y, TILE_COIN, 4);
+    direction = indep_navigate_tile(map, x, y, TILE_COIN, 4, &bot_rng);
     if(direction!=ACTION_VOID)
     {
         clientc_move(direction);
@@ -152,7 +159,7 @@ static void clientb_behaviour(void)
     }
 
     // Podąża lewą ścianą
-    direction = indep_follow_left_wall(&map, x, y, current_direction);
+    direction = indep_follow_left_wall(map, x, y, current_direction);
     if(x != last_x || y != last_y)
         current_direction = direction;
     clientc_move(current_direction);
@@ -174,8 +181,21 @@ static void *clientb_update_thread(void *ptr)
 }
 
 // Funkcja main
-int main(void)
+int main(int argc, char **argv)
 {
+    // Ziarno podane przez użytkownika pozwala powtórzyć zachowanie bota
+    unsigned long long seed = (unsigned long long)time(NULL)^((unsigned long long)getpid()<<32);
+    int opt;
+    while((opt = getopt(argc, argv, "s:")) != -1)
+    {
+        if(opt!='s' || sscanf(optarg, "%llu", &seed)!=1)
+        {
+            fprintf(stderr, "Usage: %s [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+    rng_seed_stream(&bot_rng, seed, RNG_STREAM_BOT);
+
     current_direction = ACTION_DO_NOTHING;
 
     // Dołączenie na serwer
@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <semaphore.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <ncursesw/ncurses.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -11,6 +12,7 @@
 #include "client_common.h"
 #include "client_data.h"
 #include "common.h"
+#include "display.h"
 #include "map.h"
 #include "tiles.h"
 
@@ -23,6 +25,10 @@ static int cclient_enter_free_server_slot(enum client_type_t client_type);
 int fd;
 struct clients_sm_block_t *sm_block;
 struct client_sm_block_t *my_sm_block;
+size_t shared_block_size;
+
+// Numer ostatniej akcji wstawionej do kolejki
+uint32_t input_seq;
 
 // Dane klienta - oddzielenie mechanizmu komunikacji od danych
 struct client_data_t client_data;
@@ -43,6 +49,7 @@ static void clientc_init_ncurses(void)
     cbreak();
 
     init_colors();
+    check_set_handler(display_check_failed);
 
     stat_window = newwin(12, 30, 0, 0);
     map_window = newwin(MAP_VIEW_HEIGHT+2, MAP_VIEW_WIDTH+4, 4, 40);
@@ -55,27 +62,19 @@ static void clientc_init_ncurses(void)
     wbkgdset(help_window, COLOR_PAIR(COLOR_BLACK_ON_WHITE));
 }
 
-// Znalezienie wolnego miejsca na serwerze i zabranie go
+// Znalezienie wolnego miejsca na serwerze i zabranie go - slot jest zajmowany atomowo w mapie wolnych slotów
 static int cclient_enter_free_server_slot(enum client_type_t client_type)
 {
-    int slot = -1;
+    int slot = slot_table_claim(sm_block);
+    if(slot==-1)
+        return -1;
 
-    for(int i=0; i<MAX_CLIENTS_COUNT; i++)
-    {
-        struct client_sm_block_t *client_block = sm_block->clients+i;
-        enter_cs(&client_block->data_cs);
-        if(client_block->data_block.client_type==CLIENT_TYPE_FREE)
-        {
-            slot = i;
-            client_block->data_block.client_type = client_type;
-            client_block->data_block.client_pid = getpid();
-            client_block->input_block.action = ACTION_DO_NOTHING;
-            client_block->input_block.respond_flag = 1;
-            exit_cs(&client_block->data_cs);
-            break;
-        }
-        exit_cs(&client_block->data_cs);
-    }
+    // Slot należy już do tego klienta - serwer zauważy go dopiero po zapisaniu typu
+    struct client_sm_block_t *client_block = sm_block->clients+slot;
+    input_ring_reset(&client_block->input_block);
+    __atomic_store_n(&client_block->input_block.respond_flag, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&client_block->data_block.client_pid, getpid(), __ATOMIC_RELEASE);
+    __atomic_store_n(&client_block->data_block.client_type, client_type, __ATOMIC_RELEASE);
 
     return slot;
 }
@@ -88,14 +87,20 @@ void clientc_enter_server(enum client_type_t client_type)
     fd = shm_open(SHM_FILE_NAME, O_RDWR, 0600);
     check(fd!=-1, "Server is probably not running, start server first");
 
-    sm_block = (struct clients_sm_block_t *)mmap(NULL, SHARED_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // Rozmiar tablicy slotów wybiera serwer - wynika z rozmiaru pamięci współdzielonej
+    struct stat shm_stat;
+    check(fstat(fd, &shm_stat)==0, "fstat error, press any key to quit");
+    shared_block_size = shm_stat.st_size;
+    check(shared_block_size>=SHARED_BLOCK_SIZE(0), "Server is not ready yet, press any key to quit");
+
+    sm_block = (struct clients_sm_block_t *)mmap(NULL, shared_block_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     check(sm_block!=MAP_FAILED, "mmap error, press any key to quit");
 
     int occupied_slot = cclient_enter_free_server_slot(client_type);
     check(occupied_slot!=-1, "Server is full, you are not able to join");
     my_sm_block = sm_block->clients+occupied_slot;
 
-    cd_init(&client_data, client_type, occupied_slot);
+    cd_init(&client_data, client_type, occupied_slot, sm_block->map_width, sm_block->map_height);
 }
 
 // Wyświetlenie danych gracza
@@ -139,11 +144,11 @@ void clientc_display_stats(void)
 // Czeka na dane od serwera i aktualizuje własne dane
 void clientc_wait_and_update(void)
 {
-    // Wait - czeka na dane od serwera, ograniczone czasowo
+    // Wait - czeka na dane od serwera, ograniczone czasowo - długość tury wybiera serwer
+    long long tolerated_ns = sm_block->turn_time_ns + DATA_WAITING_TIME_MAX*1000LL;
     struct timespec tolerated_time;
     clock_gettime(CLOCK_REALTIME, &tolerated_time);
-    tolerated_time.tv_sec += (TURN_TIME+DATA_WAITING_TIME_MAX) / 1000000;
-    long temp_ns = tolerated_time.tv_nsec + (TURN_TIME+DATA_WAITING_TIME_MAX)%1000000*1000;
+    long long temp_ns = tolerated_time.tv_nsec + tolerated_ns;
     tolerated_time.tv_sec += temp_ns / 1000000000;
     tolerated_time.tv_nsec = temp_ns % 1000000000;
 
@@ -152,7 +157,7 @@ void clientc_wait_and_update(void)
     {
         display_center("Server doesn't respond, exiting in 3 seconds");
         usleep(3e6);
-        munmap(sm_block, SHARED_BLOCK_SIZE);
+        munmap(sm_block, shared_block_size);
         close(fd);
         endwin();
         delwin(stat_window);
@@ -160,11 +165,11 @@ void clientc_wait_and_update(void)
         exit(0);
     }
 
-    // Update - Aktualizuje dane klienta za pomocą otrzymanych danych
-    enter_cs(&my_sm_block->data_cs);
-    my_sm_block->input_block.respond_flag = 1;
-    cd_update_with_output_block(&client_data, &my_sm_block->output_block);
-    exit_cs(&my_sm_block->data_cs);
+    // Update - Aktualizuje dane klienta za pomocą najnowszych opublikowanych danych, bez blokowania serwera
+    __atomic_store_n(&my_sm_block->input_block.respond_flag, 1, __ATOMIC_RELEASE);
+    struct client_output_block_t *output_block;
+    output_buffer_acquire(&my_sm_block->output_buffer, &output_block);
+    cd_update_with_output_block(&client_data, output_block);
 }
 
 // Automatycznie scroluje mapę jeżeli gracz jest zbyt blisko krańca
@@ -189,15 +194,22 @@ void clientc_display_map(void)
 {
     clientc_shift_if_too_far();
     map_display(&client_data.visible_map, map_window);
+    map_display_player(&client_data.visible_map, map_window, client_data.current_x, client_data.current_y, client_data.slot);
+    wrefresh(map_window);
 }
 
 // Opuszczenie serwera
 void clientc_leave_server(void)
 {
+    // Slot zwalnia ta strona, która oznaczy go jako wolny - serwer mógł to już zrobić, uznając klienta za martwego
     enter_cs(&my_sm_block->data_cs);
-    my_sm_block->data_block.client_type = CLIENT_TYPE_FREE;
+    if(my_sm_block->data_block.client_pid==getpid() && my_sm_block->data_block.client_type!=CLIENT_TYPE_FREE)
+    {
+        __atomic_store_n(&my_sm_block->data_block.client_type, CLIENT_TYPE_FREE, __ATOMIC_RELEASE);
+        slot_table_release(sm_block, client_data.slot);
+    }
     exit_cs(&my_sm_block->data_cs);
-    munmap(sm_block, SHARED_BLOCK_SIZE);
+    munmap(sm_block, shared_block_size);
     close(fd);
     endwin();
     delwin(stat_window);
@@ -205,12 +217,16 @@ void clientc_leave_server(void)
     delwin(help_window);
 }
 
-// Ruch gracza
+// Ruch gracza - akcja trafia do kolejki bez blokowania, przy pełnej kolejce jest odrzucana
 void clientc_move(enum action_t action)
 {
-    enter_cs(&my_sm_block->data_cs);
-    my_sm_block->input_block.action = action;
-    exit_cs(&my_sm_block->data_cs);
+    input_seq++;
+    input_ring_push(&my_sm_block->input_block, input_seq, action);
+
+    // Potwierdzenie akcji na ostatnią otrzymaną turę - w trybie lockstep serwer może od razu przejść do kolejnej
+    __atomic_store_n(&my_sm_block->input_block.acked_tick, client_data.tick, __ATOMIC_RELEASE);
+    if(__atomic_load_n(&sm_block->lockstep, __ATOMIC_ACQUIRE))
+        sem_post(&sm_block->lockstep_sem);
 }
 
 // Wyświetla cały interfejs klienta
@@ -224,9 +240,9 @@ void clientc_display(void)
 
 
 // Pobranie mapy znanej przez gracza 
-struct map_t clientc_get_map(void)
+struct map_t *clientc_get_map(void)
 {
-    return client_data.visible_map;
+    return &client_data.visible_map;
 }
 
 // Pobranie liczby monet pozbieranych przez gracza
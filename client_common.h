@@ -16,7 +16,7 @@ void clientc_display_stats(void);
 void clientc_display_map(void);
 void clientc_display(void);
 void clientc_wait_and_update(void);
-struct map_t clientc_get_map(void);
+struct map_t *clientc_get_map(void);
 int clientc_get_found_money(void);
 void clientc_get_pos(int *x, int *y);
 int clientc_is_campside_known(void);
@@ -4,11 +4,15 @@
 #include "map.h"
 
 // Inicjacja danych klienta
-void cd_init(struct client_data_t* cd, enum client_type_t type, int slot)
+void cd_init(struct client_data_t* cd, enum client_type_t type, int slot, int map_width, int map_height)
 {
     cd->my_pid = getpid();
     cd->type = type;
     cd->slot = slot;
+    cd->tick = 0;
+    cd->current_x = -1;
+    cd->current_y = -1;
+    map_init(&cd->visible_map, map_width, map_height);
     map_fill(&cd->visible_map, TILE_UNKNOWN);
     cd->visible_map.campside_x = -1;
     cd->visible_map.campside_y = -1;
@@ -17,14 +21,17 @@ void cd_init(struct client_data_t* cd, enum client_type_t type, int slot)
 // Aktualizacja danych klienta za pomocą output_block otrzymanego od serwera
 void cd_update_with_output_block(struct client_data_t* cd, struct client_output_block_t *output)
 {
+    // Niepewne kafelki mogą leżeć jedynie w obszarze widzianym z poprzedniej pozycji
+    map_remove_unsure_tiles(&cd->visible_map, cd->current_x, cd->current_y);
+
     cd->server_pid = output->server_pid;
     cd->round_number = output->round;
+    cd->tick = output->tick;
     cd->current_x = output->x;
     cd->current_y = output->y;
     cd->coins_found = output->coins_found;
     cd->coins_brought = output->coins_brought;
     cd->deaths = output->deaths;
 
-    map_remove_unsure_tiles(&cd->visible_map);
     map_update_with_surrounding_area(&cd->visible_map, &output->surrounding_area, output->x, output->y);
 }
\ No newline at end of file
@@ -13,6 +13,7 @@ struct client_data_t
 
     enum client_type_t type;
     int round_number;
+    uint32_t tick;
 
     int current_x;
     int current_y;
@@ -25,7 +26,7 @@ struct client_data_t
 };
 
 // Prototypy
-void cd_init(struct client_data_t* cd, enum client_type_t type, int slot);
+void cd_init(struct client_data_t* cd, enum client_type_t type, int slot, int map_width, int map_height);
 void cd_update_with_output_block(struct client_data_t* cd, struct client_output_block_t *output);
 
 #endif
\ No newline at end of file
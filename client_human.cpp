@@ -4,6 +4,7 @@
 #include <ctype.h>
 #include "client_common.h"
 #include "common.h"
+#include "display.h"
 #include "client_data.h"
 
 // Wątki
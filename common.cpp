@@ -1,45 +1,31 @@
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <pthread.h>
 #include <time.h>
+#include <errno.h>
 #include "common.h"
-#include "ncursesw/ncurses.h"
 
-// Jeżeli warunek jest nieprawidłowy to wyświetla wiadomość na środku ekranu i kończy
+// Funkcja wywoływana gdy sprawdzany warunek nie jest spełniony - domyślnie wypisuje wiadomość na stderr
+static void (*check_handler)(const char *message) = NULL;
+
+// Jeżeli warunek jest nieprawidłowy to zgłasza wiadomość i kończy
 void check(int expr, const char *message)
 {
     if(!expr)
     {
-        display_center(message);
-        getchar();
-        endwin();
+        if(check_handler!=NULL)
+            check_handler(message);
+        else
+            fprintf(stderr, "%s\n", message);
         exit(1);
     }
 }
 
-// Wyświetla wiadomość na środku ekranu
-void display_center(const char *message)
-{
-        int w = getmaxx(stdscr);
-        int h = getmaxy(stdscr);
-        clear();
-        mvprintw(h/2, (w-strlen(message))/2, message);
-        refresh();
-}
-
-// Inicjuje pary kolorów
-void init_colors(void)
+// Ustawia sposób zgłaszania niespełnionych warunków - np. wyświetlanie w oknie ncurses
+void check_set_handler(void (*handler)(const char *message))
 {
-    start_color();
-
-    init_pair(COLOR_WHITE_ON_BLACK, COLOR_WHITE, COLOR_BLACK);
-    init_pair(COLOR_BLACK_ON_WHITE, COLOR_BLACK, COLOR_WHITE);
-    init_pair(COLOR_RED_ON_WHITE, COLOR_RED, COLOR_WHITE);
-    init_pair(COLOR_BLACK_ON_YELLOW, COLOR_BLACK, COLOR_YELLOW);
-    init_pair(COLOR_WHITE_ON_MAGENTA, COLOR_WHITE, COLOR_MAGENTA);
-    init_pair(COLOR_GREEN_ON_YELLOW, COLOR_GREEN, COLOR_YELLOW);
-    init_pair(COLOR_YELLOW_ON_GREEN, COLOR_YELLOW, COLOR_GREEN);
-    init_pair(COLOR_WHITE_ON_RED, COLOR_WHITE, COLOR_RED);
+    check_handler = handler;
 }
 
 // Zwraca kierunek przeciwny do podanego
@@ -52,26 +38,164 @@ enum action_t reverse_direction(enum action_t direction)
     return direction;
 }
 
-// Wejście do sekcji krytycznej - czekanie na semaforze z pewnymi zabezpieczeniami, gdyby któryś klient wyszedł wcześniej nienaturalnie w złym momencie
-void enter_cs(sem_t *sem)
+// Inicjacja sekcji krytycznej współdzielonej między procesami - mutex odporny na śmierć właściciela
+void init_cs(pthread_mutex_t *mutex)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int res = pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    check(res==0, "pthread_mutex_init error");
+}
+
+// Wejście do sekcji krytycznej - gdy poprzedni właściciel zginął w jej trakcie sekcja jest od razu naprawiana
+// Zwraca 1 gdy sekcja była naprawiana, więc chronione dane mogą być niespójne
+int enter_cs(pthread_mutex_t *mutex)
 {
-    struct timespec tolerated_time;
-    clock_gettime(CLOCK_REALTIME, &tolerated_time);
-    tolerated_time.tv_sec += CS_WAITING_TIME_MAX / 1000000;
-    long temp_ns = tolerated_time.tv_nsec + CS_WAITING_TIME_MAX%1000000*1000;
-    tolerated_time.tv_sec += temp_ns / 1000000000;
-    tolerated_time.tv_nsec = temp_ns % 1000000000;
-    int res = sem_timedwait(sem, &tolerated_time);
-    if(res!=0)
+    int res = pthread_mutex_lock(mutex);
+    if(res==EOWNERDEAD)
     {
-        // Naprawienie sekcji krytycznej
-        sem_destroy(sem);
-        sem_init(sem, 1, 1);
+        pthread_mutex_consistent(mutex);
+        return 1;
     }
+    check(res==0, "pthread_mutex_lock error");
+    return 0;
 }
 
 // Wyjście z sekcji krytycznej - para do enter_cs
-void exit_cs(sem_t *sem)
+void exit_cs(pthread_mutex_t *mutex)
 {
-    sem_post(sem);
-}
\ No newline at end of file
+    pthread_mutex_unlock(mutex);
+}
+
+// Wstawienie akcji do kolejki - wywoływane tylko przez klienta, zwraca 0 gdy kolejka jest pełna
+int input_ring_push(struct client_input_block_t *input, uint32_t seq, enum action_t action)
+{
+    uint32_t head = input->head;
+    uint32_t tail = __atomic_load_n(&input->tail, __ATOMIC_ACQUIRE);
+    if(head-tail>=INPUT_RING_SIZE)
+        return 0;
+
+    struct input_entry_t *entry = input->entries + (head & (INPUT_RING_SIZE-1));
+    entry->seq = seq;
+    entry->action = action;
+
+    // Publikacja wpisu - serwer zobaczy go dopiero po przesunięciu head
+    __atomic_store_n(&input->head, head+1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Zdjęcie akcji z kolejki - wywoływane tylko przez serwer, zwraca 0 gdy kolejka jest pusta
+int input_ring_pop(struct client_input_block_t *input, struct input_entry_t *entry)
+{
+    uint32_t tail = input->tail;
+    uint32_t head = __atomic_load_n(&input->head, __ATOMIC_ACQUIRE);
+    uint32_t available = head-tail;
+    if(available==0)
+        return 0;
+
+    // Niespójne indeksy (np. nowy klient wyzerował kolejkę w trakcie odczytu) - kolejka jest porzucana
+    if(available>INPUT_RING_SIZE)
+    {
+        __atomic_store_n(&input->tail, head, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    *entry = input->entries[tail & (INPUT_RING_SIZE-1)];
+
+    // Zwolnienie miejsca - klient może je nadpisać dopiero po przesunięciu tail
+    __atomic_store_n(&input->tail, tail+1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Porzucenie zaległych akcji - wywoływane przez klienta przy zajmowaniu slotu
+void input_ring_reset(struct client_input_block_t *input)
+{
+    uint32_t tail = __atomic_load_n(&input->tail, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&input->head, tail, __ATOMIC_RELEASE);
+}
+
+// Oznaczenie pierwszych capacity slotów jako wolne
+void slot_table_init(struct clients_sm_block_t *table, int capacity)
+{
+    table->capacity = capacity;
+    for(int i=0; i<SLOT_BITMAP_WORDS; i++)
+    {
+        int first = i*64;
+        if(capacity>=first+64)
+            table->free_slots[i] = ~0ULL;
+        else if(capacity>first)
+            table->free_slots[i] = (1ULL<<(capacity-first))-1;
+        else
+            table->free_slots[i] = 0;
+    }
+}
+
+// Zajęcie dowolnego wolnego slotu bez blokad, zwraca -1 gdy wszystkie są zajęte
+int slot_table_claim(struct clients_sm_block_t *table)
+{
+    for(int i=0; i<SLOT_BITMAP_WORDS; i++)
+    {
+        uint64_t word = __atomic_load_n(table->free_slots+i, __ATOMIC_ACQUIRE);
+        while(word!=0)
+        {
+            int bit = __builtin_ctzll(word);
+
+            // Przy niepowodzeniu word dostaje aktualną wartość, więc pętla próbuje dalej z pozostałymi wolnymi bitami
+            if(__atomic_compare_exchange_n(table->free_slots+i, &word, word & ~(1ULL<<bit), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                return i*64+bit;
+        }
+    }
+    return -1;
+}
+
+// Zwolnienie slotu - wywoływane dokładnie raz, przez stronę która oznaczyła slot jako wolny
+void slot_table_release(struct clients_sm_block_t *table, int slot)
+{
+    __atomic_fetch_or(table->free_slots+slot/64, 1ULL<<(slot%64), __ATOMIC_RELEASE);
+}
+
+// Początkowy przydział buforów - każda strona ma swój, trzeci czeka na wymianę
+void output_buffer_init(struct client_output_buffer_t *buffer)
+{
+    buffer->back = 0;
+    buffer->middle = 1;
+    buffer->front = 2;
+}
+
+// Bufor, do którego serwer wpisuje kolejne dane - należy wyłącznie do serwera
+struct client_output_block_t *output_buffer_back(struct client_output_buffer_t *buffer)
+{
+    return buffer->blocks + buffer->back;
+}
+
+// Publikacja zapisanych danych - wywoływane tylko przez serwer, nigdy nie czeka na klienta
+void output_buffer_publish(struct client_output_buffer_t *buffer)
+{
+    uint32_t previous = __atomic_exchange_n(&buffer->middle, buffer->back | OUTPUT_BUFFER_FRESH, __ATOMIC_ACQ_REL);
+    buffer->back = previous & OUTPUT_BUFFER_INDEX_MASK;
+}
+
+// Pobranie najnowszych opublikowanych danych - wywoływane tylko przez klienta, zwraca 0 gdy od ostatniego razu nic nie doszło
+int output_buffer_acquire(struct client_output_buffer_t *buffer, struct client_output_block_t **block)
+{
+    int fresh = 0;
+    if(__atomic_load_n(&buffer->middle, __ATOMIC_ACQUIRE) & OUTPUT_BUFFER_FRESH)
+    {
+        uint32_t previous = __atomic_exchange_n(&buffer->middle, buffer->front, __ATOMIC_ACQ_REL);
+        buffer->front = previous & OUTPUT_BUFFER_INDEX_MASK;
+        fresh = 1;
+    }
+
+    *block = buffer->blocks + buffer->front;
+    return fresh;
+}
+
+// Odtworzenie indeksu bufora klienta - wywoływane przez serwer po usunięciu klienta, który mógł zginąć w trakcie wymiany
+void output_buffer_repair_reader(struct client_output_buffer_t *buffer)
+{
+    uint32_t middle = __atomic_load_n(&buffer->middle, __ATOMIC_ACQUIRE) & OUTPUT_BUFFER_INDEX_MASK;
+    buffer->front = OUTPUT_BUFFERS_COUNT - buffer->back - middle;
+}
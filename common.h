@@ -2,34 +2,32 @@
 #define __COMMON_H__
 
 #include <semaphore.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <assert.h>
-#include <ncursesw/ncurses.h>
 #include "tiles.h"
 
-// Kolory
-#define COLOR_WHITE_ON_BLACK    1
-#define COLOR_BLACK_ON_WHITE    2
-#define COLOR_RED_ON_WHITE      3
-#define COLOR_BLACK_ON_YELLOW   4
-#define COLOR_WHITE_ON_MAGENTA  5
-#define COLOR_GREEN_ON_YELLOW   6
-#define COLOR_YELLOW_ON_GREEN   7
-#define COLOR_WHITE_ON_RED      8
-
 // Ile monet znajduje się w skarbach
 #define SMALL_TREASURE_VALUE 10
 #define BIG_TREASURE_VALUE 50
 
-// Maksymalna liczba graczy
-#define MAX_CLIENTS_COUNT 4
+// Domyślna i największa możliwa liczba graczy - właściwa liczba slotów wybierana jest przy starcie serwera
+#define DEFAULT_CLIENTS_COUNT 4
+#define MAX_CLIENTS_COUNT 1024
 
-// Rozmiar mapy
-#define MAP_WIDTH 127
-#define MAP_HEIGHT 127
+// Liczba słów mapy bitowej wolnych slotów
+#define SLOT_BITMAP_WORDS (MAX_CLIENTS_COUNT/64)
 
+// Domyślny, najmniejszy i największy rozmiar mapy - właściwy rozmiar wybierany jest przy starcie serwera
 // Rozmiary mapy muszą być nieparzyste by algorym generacji labiryntu działał
-static_assert(MAP_WIDTH%2==1, "MAP_WIDTH must be odd");
-static_assert(MAP_HEIGHT%2==1, "MAP_HEIGHT must be odd");
+#define DEFAULT_MAP_WIDTH 127
+#define DEFAULT_MAP_HEIGHT 127
+#define MAP_MIN_SIZE 7
+#define MAP_MAX_SIZE 4095
+
+static_assert(DEFAULT_MAP_WIDTH%2==1, "DEFAULT_MAP_WIDTH must be odd");
+static_assert(DEFAULT_MAP_HEIGHT%2==1, "DEFAULT_MAP_HEIGHT must be odd");
+static_assert(MAP_MIN_SIZE%2==1 && MAP_MAX_SIZE%2==1, "map size limits must be odd");
 
 // Rozmiar widocznego okna, gdy większe od mapy to pojawiają się suwaki
 #define MAP_VIEW_WIDTH 90
@@ -41,17 +39,26 @@ static_assert(MAP_HEIGHT%2==1, "MAP_HEIGHT must be odd");
 
 // Pamięć współdzielona
 #define SHM_FILE_NAME "game_shm"
-#define SHARED_BLOCK_SIZE sizeof(struct clients_sm_block_t)
+#define SHARED_BLOCK_SIZE(__capacity) (sizeof(struct clients_sm_block_t)+(__capacity)*sizeof(struct client_sm_block_t))
 
 // Czas trwania jednej tury
 #define TURN_TIME 250000
 
-// Maksymalny czas czekana na dostanie się do sekcji krytycznej - po tym czasei resetujemy sekcje
-#define CS_WAITING_TIME_MAX 100
-
 // Maksymalny margines czas czekania na dane od serwera - po tym czasie uznajemy że serwer nie odpowiada
+// Tyle samo serwer czeka na odpowiedź klienta, zanim go usunie
 #define DATA_WAITING_TIME_MAX 1000000
 
+// Rozmiar kolejki akcji klienta (potęga dwójki) - nadmiarowe akcje są odrzucane
+#define INPUT_RING_SIZE 4
+
+// Ile akcji z kolejki serwer wykonuje w jednej turze
+#define INPUT_ACTIONS_PER_TICK 1
+
+// Liczba buforów danych wysyłanych do klienta i flaga świeżych danych w indeksie bufora środkowego
+#define OUTPUT_BUFFERS_COUNT 3
+#define OUTPUT_BUFFER_FRESH 0x4
+#define OUTPUT_BUFFER_INDEX_MASK 0x3
+
 // Typ klienta
 enum client_type_t 
 { 
@@ -77,13 +84,25 @@ enum action_t
 // Najbliższe otoczenie gracza o promieniu VISIBLE_DISTANCE wysyłane klientom przez serwer
 typedef enum tile_t surrounding_area_t[VISIBLE_AREA_SIZE][VISIBLE_AREA_SIZE];
 
+// Akcja w kolejce klienta wraz z jej numerem kolejnym
+struct input_entry_t
+{
+    uint32_t seq;
+    enum action_t action;
+};
+
 // Dane wstawiane przez klienta, a odczytywane przez serwer
+// Kolejka akcji bez blokad - jeden producent (klient) przesuwa head, jeden konsument (serwer) przesuwa tail
 struct client_input_block_t
 {
-    enum action_t action;
+    uint32_t head;
+    uint32_t tail;
+    struct input_entry_t entries[INPUT_RING_SIZE];
     int respond_flag;
-} 
-__attribute__((packed));
+
+    // Numer ostatniej tury, na którą klient wysłał akcję - w trybie lockstep serwer czeka na wszystkich klientów
+    uint32_t acked_tick;
+};
 
 // Dane wstawiane przez serwer, a odczytywane przez klienta
 struct client_output_block_t
@@ -100,41 +119,81 @@ struct client_output_block_t
 
     int round;
     int server_pid;
+
+    // Numer ostatniej akcji klienta wykonanej przez serwer
+    uint32_t input_ack;
+
+    // Numer tury, po której wysłano te dane
+    uint32_t tick;
 } 
 __attribute__((packed));
 
-// Dane używane przez serwer i klienta jednocześnie
+// Potrójny bufor danych wysyłanych do klienta - serwer pisze do bufora back, klient czyta z bufora front,
+// a bufor środkowy jest wymieniany atomowo, więc żadna ze stron nie czeka na drugą i nie widzi niepełnych danych
+struct client_output_buffer_t
+{
+    struct client_output_block_t blocks[OUTPUT_BUFFERS_COUNT];
+    uint32_t back;
+    uint32_t middle;
+    uint32_t front;
+};
+
+// Dane używane przez serwer i klienta jednocześnie - odczytywane atomowo, więc bez pakowania
 struct client_data_block_t
 {
     int client_pid;
     enum client_type_t client_type;
-}
-__attribute__((packed));
+};
 
 // Dane dla jednego klienta umieszczone w pamięci współdzielonej
+// Bez pakowania - indeksy kolejki, semafory i muteksy muszą być wyrównane, by operacje atomowe były poprawne
 struct client_sm_block_t
 {
-    sem_t data_cs;
+    pthread_mutex_t data_cs;
     struct client_data_block_t data_block;
     struct client_input_block_t input_block;
-    struct client_output_block_t output_block;
+    struct client_output_buffer_t output_buffer;
     sem_t output_block_sem;
-} 
-__attribute__((packed));
+};
 
-// Dane wszystkich klientów umieszczone w pamięci współdzielonej
+// Dane wszystkich klientów umieszczone w pamięci współdzielonej - liczba slotów ustalana przez serwer
+// Ustawiony bit mapy free_slots oznacza wolny slot, zajęcie slotu to atomowe wyzerowanie bitu
 struct clients_sm_block_t
 {
-    struct client_sm_block_t clients[MAX_CLIENTS_COUNT];
-} 
-__attribute__((packed));
+    int capacity;
+    uint64_t free_slots[SLOT_BITMAP_WORDS];
+
+    // Rozmiar mapy wybrany przez serwer
+    int map_width;
+    int map_height;
+
+    // Najdłuższy odstęp między kolejnymi danymi od serwera - klienci czekają tyle i jeszcze DATA_WAITING_TIME_MAX
+    long long turn_time_ns;
+
+    // Tryb lockstep - klienci sygnalizują semafor po wysłaniu akcji na bieżącą turę
+    int lockstep;
+    sem_t lockstep_sem;
+
+    struct client_sm_block_t clients[];
+};
 
 // Prototypy funkcji
 void check(int expr, const char *message);
-void display_center(const char *message);
-void init_colors(void);
+void check_set_handler(void (*handler)(const char *message));
 enum action_t reverse_direction(enum action_t direction);
-void enter_cs(sem_t *sem);
-void exit_cs(sem_t *sem);
+void init_cs(pthread_mutex_t *mutex);
+int enter_cs(pthread_mutex_t *mutex);
+void exit_cs(pthread_mutex_t *mutex);
+int input_ring_push(struct client_input_block_t *input, uint32_t seq, enum action_t action);
+int input_ring_pop(struct client_input_block_t *input, struct input_entry_t *entry);
+void input_ring_reset(struct client_input_block_t *input);
+void slot_table_init(struct clients_sm_block_t *table, int capacity);
+int slot_table_claim(struct clients_sm_block_t *table);
+void slot_table_release(struct clients_sm_block_t *table, int slot);
+void output_buffer_init(struct client_output_buffer_t *buffer);
+struct client_output_block_t *output_buffer_back(struct client_output_buffer_t *buffer);
+void output_buffer_publish(struct client_output_buffer_t *buffer);
+int output_buffer_acquire(struct client_output_buffer_t *buffer, struct client_output_block_t **block);
+void output_buffer_repair_reader(struct client_output_buffer_t *buffer);
 
 #endif
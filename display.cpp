@@ -0,0 +1,191 @@
+#include <string.h>
+#include <stdlib.h>
+#include <ncursesw/ncurses.h>
+#include "display.h"
+#include "common.h"
+#include "map.h"
+#include "tiles.h"
+
+// Wygląd przypisany poszczególnym kafelkom
+const chtype associated_appearance[] =
+{
+    ' ' | COLOR_PAIR(COLOR_BLACK_ON_WHITE),
+    ' ' | COLOR_PAIR(COLOR_WHITE_ON_BLACK),
+    ' ' | COLOR_PAIR(COLOR_BLACK_ON_WHITE),
+    'A' | COLOR_PAIR(COLOR_YELLOW_ON_GREEN),
+    '#' | COLOR_PAIR(COLOR_BLACK_ON_WHITE),
+    '*' | COLOR_PAIR(COLOR_RED_ON_WHITE),
+    'c' | COLOR_PAIR(COLOR_BLACK_ON_YELLOW),
+    't' | COLOR_PAIR(COLOR_BLACK_ON_YELLOW),
+    'T' | COLOR_PAIR(COLOR_BLACK_ON_YELLOW),
+    'D' | COLOR_PAIR(COLOR_GREEN_ON_YELLOW),
+    '.' | COLOR_PAIR(COLOR_BLACK_ON_WHITE),
+
+    'P' | COLOR_PAIR(COLOR_WHITE_ON_MAGENTA)
+};
+
+// Oznaczenia graczy o znanym numerze - gracze o dalszych numerach wyglądają jak TILE_PLAYER
+static const char player_labels[] = "123456789";
+
+// Wyświetla wiadomość na środku ekranu
+void display_center(const char *message)
+{
+        int w = getmaxx(stdscr);
+        int h = getmaxy(stdscr);
+        clear();
+        mvprintw(h/2, (w-strlen(message))/2, message);
+        refresh();
+}
+
+// Inicjuje pary kolorów
+void init_colors(void)
+{
+    start_color();
+
+    init_pair(COLOR_WHITE_ON_BLACK, COLOR_WHITE, COLOR_BLACK);
+    init_pair(COLOR_BLACK_ON_WHITE, COLOR_BLACK, COLOR_WHITE);
+    init_pair(COLOR_RED_ON_WHITE, COLOR_RED, COLOR_WHITE);
+    init_pair(COLOR_BLACK_ON_YELLOW, COLOR_BLACK, COLOR_YELLOW);
+    init_pair(COLOR_WHITE_ON_MAGENTA, COLOR_WHITE, COLOR_MAGENTA);
+    init_pair(COLOR_GREEN_ON_YELLOW, COLOR_GREEN, COLOR_YELLOW);
+    init_pair(COLOR_YELLOW_ON_GREEN, COLOR_YELLOW, COLOR_GREEN);
+    init_pair(COLOR_WHITE_ON_RED, COLOR_WHITE, COLOR_RED);
+}
+
+// Zgłoszenie niespełnionego warunku w oknie ncurses - instalowane przez check_set_handler
+void display_check_failed(const char *message)
+{
+    display_center(message);
+    getchar();
+    endwin();
+}
+
+// Funkcja wyświetlająca mapę w podanym oknie
+void map_display(struct map_t *map, WINDOW *window)
+{
+    werase(window);
+
+    // Wyświetla mape
+    for(int i=0; i<MAP_VIEW_HEIGHT; i++)
+    {
+        for(int j=0; j<MAP_VIEW_WIDTH; j++)
+        {
+            int map_y = map->viewpoint_y + i;
+            int map_x = map->viewpoint_x + j;
+
+            enum tile_t tile = map_get_tile(map, map_x, map_y);
+            const chtype color_character = tile_get_appearance(tile);
+
+            int display_x = j+2;
+            int display_y = i+1;
+
+            if(map->width<MAP_VIEW_WIDTH) display_x += (MAP_VIEW_WIDTH-map->width)/2;
+            if(map->height<MAP_VIEW_HEIGHT) display_y += (MAP_VIEW_HEIGHT-map->height)/2;
+
+            mvwaddch(window, display_y, display_x, color_character);
+        }
+    }
+
+    // Wyświetl ramke
+    for(int i=0; i<MAP_VIEW_WIDTH+2; i++)
+    {
+        mvwaddch(window, MAP_VIEW_HEIGHT+1, i, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
+        mvwaddch(window, 0, i, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
+    }
+    for(int i=0; i<MAP_VIEW_HEIGHT+2; i++)
+    {
+        mvwaddch(window, i, 0, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
+        mvwaddch(window, i, 1, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
+        mvwaddch(window, i, MAP_VIEW_WIDTH+2, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
+        mvwaddch(window, i, MAP_VIEW_WIDTH+3, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
+    }
+
+    // Wyświetla poziomy pasek przewijania
+    if(map->width>MAP_VIEW_WIDTH)
+    {
+        int viewpoint_max = map->width-MAP_VIEW_WIDTH;
+        int pos = map->viewpoint_x*(MAP_VIEW_WIDTH-3)/viewpoint_max+2;
+        mvwaddch(window, MAP_VIEW_HEIGHT+1, pos, ' '|COLOR_PAIR(COLOR_WHITE_ON_MAGENTA));
+        mvwaddch(window, MAP_VIEW_HEIGHT+1, pos+1, ' '|COLOR_PAIR(COLOR_WHITE_ON_MAGENTA));
+    }
+
+    // Wyświetla pionowy pasek przewijania
+    if(map->height>MAP_VIEW_HEIGHT)
+    {
+        int viewpoint_max = map->height-MAP_VIEW_HEIGHT;
+        int pos = map->viewpoint_y*(MAP_VIEW_HEIGHT-1)/viewpoint_max+1;
+        mvwaddch(window, pos, MAP_VIEW_WIDTH+2, ' '|COLOR_PAIR(COLOR_WHITE_ON_MAGENTA));
+        mvwaddch(window, pos, MAP_VIEW_WIDTH+3, ' '|COLOR_PAIR(COLOR_WHITE_ON_MAGENTA));
+    }
+
+    wrefresh(window);
+}
+
+// Nanosi na wyświetloną mapę gracza o znanym numerze slotu - kafelek TILE_PLAYER nie mówi który to gracz
+// Nie odświeża okna, by można było nanieść wielu graczy naraz
+void map_display_player(struct map_t *map, WINDOW *window, int x, int y, int slot)
+{
+    // Gracz przykryty przez wyższą warstwę (obóz, bestia) nie jest widoczny
+    if(map_get_tile(map, x, y)!=TILE_PLAYER)
+        return;
+
+    int view_x = x - map->viewpoint_x;
+    int view_y = y - map->viewpoint_y;
+    if(view_x<0 || view_y<0 || view_x>=MAP_VIEW_WIDTH || view_y>=MAP_VIEW_HEIGHT)
+        return;
+
+    int display_x = view_x+2;
+    int display_y = view_y+1;
+
+    if(map->width<MAP_VIEW_WIDTH) display_x += (MAP_VIEW_WIDTH-map->width)/2;
+    if(map->height<MAP_VIEW_HEIGHT) display_y += (MAP_VIEW_HEIGHT-map->height)/2;
+
+    chtype appearance = tile_get_appearance(TILE_PLAYER);
+    if(slot>=0 && slot<(int)sizeof(player_labels)-1)
+        appearance = player_labels[slot] | COLOR_PAIR(COLOR_WHITE_ON_MAGENTA);
+
+    mvwaddch(window, display_y, display_x, appearance);
+}
+
+// Zwraca wygląd danego kafelka
+const chtype tile_get_appearance(enum tile_t tile)
+{
+    int index = (int)tile;
+    return associated_appearance[index];
+}
+
+// Wyświetla w oknie wyjaśnienia do gry
+void display_help_window(WINDOW *window)
+{
+    werase(window);
+    int line = 0;
+
+    wattron(window, COLOR_PAIR(COLOR_WHITE_ON_RED));
+    mvwprintw(window, line++, 0, "Legend:");
+    wattron(window, COLOR_PAIR(COLOR_BLACK_ON_WHITE));
+
+    line++;
+
+    enum tile_t tiles[] = {TILE_PLAYER, 
+    TILE_COIN, TILE_S_TREASURE, TILE_L_TREASURE, TILE_CAMPSIDE, TILE_DROP, TILE_WALL, TILE_UNKNOWN, TILE_BUSH, TILE_BEAST };
+
+    const char *names[] = {"Player",
+    "Coint", "Small Treasure", "Large Treasure", "Campside", "Dropped Treasure", "Wall", "Unknown", "Bush", "Beast"};
+
+    mvwaddch(window, line, 1, '1' | COLOR_PAIR(COLOR_WHITE_ON_MAGENTA));
+    mvwprintw(window, line++, 5, "Player 1..9");
+
+    for(int i=0; i<10; i++)
+    {
+        mvwaddch(window, line, 1, tile_get_appearance(tiles[i]));
+        mvwprintw(window, line++, 5, names[i]);
+    }
+
+    line++;
+
+    wattron(window, COLOR_PAIR(COLOR_WHITE_ON_RED));
+    mvwprintw(window, line++, 0, "By Lukasz Klimkiewicz");
+    wattron(window, COLOR_PAIR(COLOR_BLACK_ON_WHITE));
+
+    wrefresh(window);
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef __DISPLAY_H__
+#define __DISPLAY_H__
+
+#include <ncursesw/ncurses.h>
+#include "map.h"
+#include "tiles.h"
+
+// Kolory
+#define COLOR_WHITE_ON_BLACK    1
+#define COLOR_BLACK_ON_WHITE    2
+#define COLOR_RED_ON_WHITE      3
+#define COLOR_BLACK_ON_YELLOW   4
+#define COLOR_WHITE_ON_MAGENTA  5
+#define COLOR_GREEN_ON_YELLOW   6
+#define COLOR_YELLOW_ON_GREEN   7
+#define COLOR_WHITE_ON_RED      8
+
+// Prototypy
+void display_center(const char *message);
+void display_check_failed(const char *message);
+void init_colors(void);
+const chtype tile_get_appearance(enum tile_t tile);
+void display_help_window(WINDOW *window);
+void map_display(struct map_t *map, WINDOW *window);
+void map_display_player(struct map_t *map, WINDOW *window, int x, int y, int slot);
+
+#endif
\ No newline at end of file
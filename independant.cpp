@@ -1,73 +1,265 @@
 #include <stdlib.h>
+#include <stdint.h>
+#include <vector>
 #include "independant.h"
 #include "common.h"
 #include "map.h"
+#include "rng.h"
 #include "tiles.h"
 
+// Bufory robocze przeszukiwania wszerz - utrzymywane między wywołaniami, osobne dla każdego wątku
+struct indep_bfs_t
+{
+    std::vector<uint32_t> stamp;
+    std::vector<int> depth;
+    std::vector<uint8_t> first_moves;
+    std::vector<int> queue;
+    uint32_t current_stamp;
+};
+
+static thread_local struct indep_bfs_t bfs;
+
+// Przesunięcia odpowiadające kolejnym kierunkom - kolejność zgodna z bitami masek first_moves i z MAP_DIR_*
+static const int indep_dir_x[4] = { -1, 1, 0, 0 };
+static const int indep_dir_y[4] = { 0, 0, -1, 1 };
+static const enum action_t indep_dir_action[4] = { ACTION_GO_LEFT, ACTION_GO_RIGHT, ACTION_GO_UP, ACTION_GO_DOWN };
+
 // Funkcje statyczne
-static enum action_t indep_navigate_tile_recursion(struct map_t *map, int sx, int sy, enum tile_t dst, int distance);
+static void indep_bfs_prepare(int cells_count);
+static enum action_t indep_pick_direction(uint8_t moves, unsigned random);
 
-// Funkcja znajdująca najkrótszą drogę z danego punktu do najgliższego kafelka dst, ale nie dłuższą niż distance
-enum action_t indep_navigate_tile(struct map_t *map, int sx, int sy, enum tile_t dst, int distance)
+// Przygotowuje bufory robocze do kolejnego przeszukiwania - bez czyszczenia całych tablic
+static void indep_bfs_prepare(int cells_count)
 {
-    for(int i=0; i<=distance; i++)
+    if((int)bfs.stamp.size()!=cells_count)
     {
-        struct map_t copy = *map;
-        enum action_t direction = indep_navigate_tile_recursion(&copy, sx, sy, dst, i);
-        if(direction!=ACTION_VOID) return direction;
+        bfs.stamp.assign(cells_count, 0);
+        bfs.depth.resize(cells_count);
+        bfs.first_moves.resize(cells_count);
+        bfs.queue.resize(cells_count);
+        bfs.current_stamp = 0;
+    }
+
+    bfs.current_stamp++;
+
+    // Przepełnienie licznika - jednorazowe czyszczenie znaczników
+    if(bfs.current_stamp==0)
+    {
+        bfs.stamp.assign(cells_count, 0);
+        bfs.current_stamp = 1;
     }
-    return ACTION_VOID;
 }
 
-// Funkcja rekurencyjna znajdująca drogę
-static enum action_t indep_navigate_tile_recursion(struct map_t *map, int sx, int sy, enum tile_t dst, int distance)
+// Wybiera jeden z kierunków zapisanych w masce na podstawie podanej liczby losowej
+static enum action_t indep_pick_direction(uint8_t moves, unsigned random)
 {
-    if(map_get_tile(map, sx, sy)==dst) 
-        return ACTION_DO_NOTHING;
-
-    map_set_tile(map, sx, sy, TILE_WALL);
+    int possible_ways = 0;
+    for(int i=0; i<4; i++)
+    {
+        if(moves & (1<<i))
+            possible_ways++;
+    }
 
-    distance--;
-    if(distance<0)
+    if(possible_ways==0)
         return ACTION_VOID;
 
-    enum action_t results[4] = { ACTION_VOID, ACTION_VOID, ACTION_VOID, ACTION_VOID };
+    int way = random%possible_ways;
 
-    if(tile_is_walkable(map_get_tile(map, sx-1, sy)) || map_get_tile(map, sx-1, sy)==dst) results[0] = indep_navigate_tile_recursion(map, sx-1, sy, dst, distance);
-    if(tile_is_walkable(map_get_tile(map, sx+1, sy)) || map_get_tile(map, sx+1, sy)==dst) results[1] = indep_navigate_tile_recursion(map, sx+1, sy, dst, distance);
-    if(tile_is_walkable(map_get_tile(map, sx, sy-1)) || map_get_tile(map, sx, sy-1)==dst) results[2] = indep_navigate_tile_recursion(map, sx, sy-1, dst, distance);
-    if(tile_is_walkable(map_get_tile(map, sx, sy+1)) || map_get_tile(map, sx, sy+1)==dst) results[3] = indep_navigate_tile_recursion(map, sx, sy+1, dst, distance);
-
-    int possible_ways = 0;
+    for(int i=0; i<4; i++)
+    {
+        if(moves & (1<<i))
+        {
+            if(way==0)
+                return indep_dir_action[i];
+            way--;
+        }
+    }
+    return ACTION_VOID;
+}
 
-    if(results[0]!=ACTION_VOID) possible_ways++;
-    if(results[1]!=ACTION_VOID) possible_ways++;
-    if(results[2]!=ACTION_VOID) possible_ways++;
-    if(results[3]!=ACTION_VOID) possible_ways++;
+// Funkcja znajdująca najkrótszą drogę z danego punktu do najgliższego kafelka dst, ale nie dłuższą niż distance
+// Przeszukiwanie wszerz warstwami - każda komórka pamięta maskę pierwszych ruchów prowadzących do niej najkrótszą drogą,
+// dzięki czemu spośród równie krótkich dróg kierunek jest losowany z generatora rng wywołującego
+// Komórki numerowane są jak kafelki mapy z ramką - ramka jest nieprzechodnia, więc sąsiadów nie trzeba sprawdzać z granicami
+enum action_t indep_navigate_tile(struct map_t *map, int sx, int sy, enum tile_t dst, int distance, struct rng_t *rng)
+{
+    if(map_get_tile(map, sx, sy)==dst)
+        return ACTION_DO_NOTHING;
 
-    if(possible_ways==0) 
+    if(sx<0 || sy<0 || sx>=map->width || sy>=map->height)
         return ACTION_VOID;
 
-    int way = rand()%possible_ways;
+    indep_bfs_prepare(map->tiles.size());
 
-    for(int i=0; i<4; i++)
+    const enum tile_t *tiles = map->tiles.data();
+    int stride = map->stride;
+
+    int start = map_index(map, sx, sy);
+    bfs.stamp[start] = bfs.current_stamp;
+    bfs.depth[start] = 0;
+    bfs.first_moves[start] = 0;
+    bfs.queue[0] = start;
+
+    int layer_begin = 0;
+    int layer_end = 1;
+
+    for(int depth=0; depth<distance && layer_begin<layer_end; depth++)
     {
-        if(results[i]!=ACTION_VOID) 
+        int next_end = layer_end;
+
+        for(int q=layer_begin; q<layer_end; q++)
         {
-            if(way==0) 
+            int cell = bfs.queue[q];
+
+            for(int dir=0; dir<4; dir++)
             {
-                if(i==0) return ACTION_GO_LEFT;
-                else if(i==1) return ACTION_GO_RIGHT;
-                else if(i==2) return ACTION_GO_UP;
-                else if(i==3) return ACTION_GO_DOWN;
+                int neighbour = map_neighbour_index(stride, cell, dir);
+                enum tile_t tile = tiles[neighbour];
+                if(!tile_is_walkable(tile) && tile!=dst)
+                    continue;
+
+                uint8_t moves = depth==0 ? (uint8_t)(1<<dir) : bfs.first_moves[cell];
+
+                // Komórka nieodwiedzona - trafia do następnej warstwy
+                if(bfs.stamp[neighbour]!=bfs.current_stamp)
+                {
+                    bfs.stamp[neighbour] = bfs.current_stamp;
+                    bfs.depth[neighbour] = depth+1;
+                    bfs.first_moves[neighbour] = moves;
+                    bfs.queue[next_end++] = neighbour;
+                }
+
+                // Komórka już jest w następnej warstwie - inna, równie krótka droga
+                else if(bfs.depth[neighbour]==depth+1)
+                    bfs.first_moves[neighbour] |= moves;
             }
-            way--;
         }
+
+        // Sprawdzenie czy w nowej warstwie znajduje się cel
+        uint8_t found_moves = 0;
+        for(int q=layer_end; q<next_end; q++)
+        {
+            int cell = bfs.queue[q];
+            if(tiles[cell]==dst)
+                found_moves |= bfs.first_moves[cell];
+        }
+
+        if(found_moves!=0)
+            return indep_pick_direction(found_moves, (unsigned)(rng_next(rng)>>32));
+
+        layer_begin = layer_end;
+        layer_end = next_end;
     }
+
     return ACTION_VOID;
 }
 
-// W którą stroną powinien pójść gracz, aby podążać lewą ścianą
+// Buduje pole odległości od wielu źródeł jednocześnie (mapa Dijkstry) - przeszukiwanie wszerz ograniczone do max_distance
+// Komórki numerowane są jak kafelki mapy z ramką, tak samo jak w indep_navigate_tile
+void indep_distance_field_build(struct indep_distance_field_t *field, struct map_t *map, const int *sources_x, const int *sources_y, int sources_count, int max_distance)
+{
+    int width = map->width;
+    int height = map->height;
+    int cells_count = map->tiles.size();
+    if((int)field->stamp.size()!=cells_count || field->width!=width)
+    {
+        field->width = width;
+        field->height = height;
+        field->stride = map->stride;
+        field->stamp.assign(cells_count, 0);
+        field->distance.resize(cells_count);
+        field->queue.resize(cells_count);
+        field->current_stamp = 0;
+    }
+
+    field->current_stamp++;
+    if(field->current_stamp==0)
+    {
+        field->stamp.assign(cells_count, 0);
+        field->current_stamp = 1;
+    }
+
+    int queue_end = 0;
+    for(int i=0; i<sources_count; i++)
+    {
+        int x = sources_x[i];
+        int y = sources_y[i];
+        if(x<0 || y<0 || x>=width || y>=height)
+            continue;
+
+        int cell = map_index(map, x, y);
+        if(field->stamp[cell]==field->current_stamp)
+            continue;
+
+        field->stamp[cell] = field->current_stamp;
+        field->distance[cell] = 0;
+        field->queue[queue_end++] = cell;
+    }
+
+    const enum tile_t *tiles = map->tiles.data();
+    int stride = map->stride;
+
+    for(int q=0; q<queue_end; q++)
+    {
+        int cell = field->queue[q];
+        int depth = field->distance[cell];
+        if(depth>=max_distance)
+            continue;
+
+        for(int dir=0; dir<4; dir++)
+        {
+            int neighbour = map_neighbour_index(stride, cell, dir);
+            if(field->stamp[neighbour]==field->current_stamp)
+                continue;
+
+            if(!tile_is_walkable(tiles[neighbour]))
+                continue;
+
+            field->stamp[neighbour] = field->current_stamp;
+            field->distance[neighbour] = depth+1;
+            field->queue[queue_end++] = neighbour;
+        }
+    }
+}
+
+// Odległość danej komórki od najbliższego źródła pola (lub -1 gdy poza zasięgiem)
+int indep_distance_field_get(struct indep_distance_field_t *field, int x, int y)
+{
+    if(field->stamp.empty() || x<0 || y<0 || x>=field->width || y>=field->height)
+        return -1;
+
+    int cell = map_layout_index(field->stride, x, y);
+    if(field->stamp[cell]!=field->current_stamp)
+        return -1;
+    return field->distance[cell];
+}
+
+// Kierunek zejścia po polu odległości w stronę najbliższego źródła, droga nie dłuższa niż distance
+// Spośród równie dobrych kierunków wybór zależy od podanej liczby losowej
+enum action_t indep_distance_field_step(struct indep_distance_field_t *field, int x, int y, int distance, unsigned random)
+{
+    int best = -1;
+    uint8_t moves = 0;
+
+    for(int dir=0; dir<4; dir++)
+    {
+        int d = indep_distance_field_get(field, x+indep_dir_x[dir], y+indep_dir_y[dir]);
+        if(d<0 || d+1>distance)
+            continue;
+
+        if(best==-1 || d<best)
+        {
+            best = d;
+            moves = (uint8_t)(1<<dir);
+        }
+        else if(d==best)
+            moves |= (uint8_t)(1<<dir);
+    }
+
+    return indep_pick_direction(moves, random);
+}
+
+// W którą stroną powinien pójść gracz, aby podążać lewą ścianą - gracz musi stać na mapie
 action_t indep_follow_left_wall(struct map_t *map, int x, int y, action_t current_direction)
 {
     if(current_direction==ACTION_DO_NOTHING)
@@ -88,7 +280,7 @@ action_t indep_follow_left_wall(struct map_t *map, int x, int y, action_t curren
         else if(current_direction==ACTION_GO_RIGHT)
             left_y--;
 
-        enum tile_t left_tile = map_get_tile(map, left_x, left_y);
+        enum tile_t left_tile = map_tile_at(map, left_x, left_y);
 
         if(tile_is_walkable(left_tile))
         {
@@ -1,11 +1,31 @@
 #ifndef __INDEPENDANT_H__
 #define __INDEPENDANT_H__
 
+#include <stdint.h>
+#include <vector>
 #include "common.h"
+#include "rng.h"
 #include "tiles.h"
 
+// Pole odległości od najbliższego ze źródeł - bufory utrzymywane między kolejnymi budowami
+struct indep_distance_field_t
+{
+    std::vector<uint32_t> stamp;
+    std::vector<int> distance;
+    std::vector<int> queue;
+    uint32_t current_stamp;
+
+    // Rozmiar mapy, na której pole zostało zbudowane - komórki numerowane jak kafelki tej mapy
+    int width;
+    int height;
+    int stride;
+};
+
 // Prototypy
-enum action_t indep_navigate_tile(struct map_t *map, int sx, int sy, enum tile_t dst, int distance);
+enum action_t indep_navigate_tile(struct map_t *map, int sx, int sy, enum tile_t dst, int distance, struct rng_t *rng);
+void indep_distance_field_build(struct indep_distance_field_t *field, struct map_t *map, const int *sources_x, const int *sources_y, int sources_count, int max_distance);
+int indep_distance_field_get(struct indep_distance_field_t *field, int x, int y);
+enum action_t indep_distance_field_step(struct indep_distance_field_t *field, int x, int y, int distance, unsigned random);
 action_t indep_follow_left_wall(struct map_t *map, int x, int y, action_t current_direction);
 
 #endif
\ No newline at end of file
@@ -1,111 +1,90 @@
-#include <ncursesw/ncurses.h>
 #include <stdlib.h>
+#include <string.h>
+#include <vector>
 #include "map.h"
 #include "common.h"
+#include "rng.h"
 #include "tiles.h"
 
+// Generator labiryntu zagląda dwa kafelki za krawędź mapy
+static_assert(MAP_BORDER>=2, "maze generator needs a border at least two tiles wide");
+
 // Funkcje statyczne
-static void map_maze_recur(struct map_t *map, int x, int y);
-static void map_add_bush(struct map_t *map);
+static void map_add_bush(struct map_t *map, struct map_free_cells_t *free_cells, struct rng_t *rng);
+
+// Przygotowanie pustej mapy danego rozmiaru - jedyne miejsce, w którym pamięć mapy jest alokowana
+void map_init(struct map_t *map, int width, int height)
+{
+    map->viewpoint_x = 0;
+    map->viewpoint_y = 0;
+    map->campside_x = 0;
+    map->campside_y = 0;
+    map->width = width;
+    map->height = height;
+    map->stride = width+2*MAP_BORDER;
+    map->tiles.assign(map_layout_size(width, height), TILE_VOID);
+}
 
 // Funckcja zwracająca kafelek w danych miejscu (lub TILE_VOID)
 enum tile_t map_get_tile(struct map_t *map, int x, int y)
 {
-    if(x<0 || y<0 || x>=MAP_WIDTH || y>=MAP_HEIGHT)
+    if(x<0 || y<0 || x>=map->width || y>=map->height)
         return TILE_VOID;
     else 
-        return map->map[y][x];
+        return map_tile_at(map, x, y);
 }
 
-// Funkcja ustalająca dany kafelek na mapie (albo i nie)
+// Funkcja ustalająca dany kafelek na mapie (albo i nie) - ramka zawsze zostaje pusta
 void map_set_tile(struct map_t *map, int x, int y, enum tile_t tile)
 {
-    if(x<0 || y<0 || x>MAP_WIDTH || y>MAP_HEIGHT)
+    if(x<0 || y<0 || x>=map->width || y>=map->height)
         return;
     else
-        map->map[y][x] = tile;
+        map->tiles[map_index(map, x, y)] = tile;
 }
 
-// Funkcja wyświetlająca mapę w podanym oknie
-void map_display(struct map_t *map, WINDOW *window)
+// Kopiowanie mapy - obie mapy muszą mieć ten sam rozmiar
+void map_copy(const struct map_t *source, struct map_t *destination)
 {
-    werase(window);
-
-    // Wyświetla mape
-    for(int i=0; i<MAP_VIEW_HEIGHT; i++)
-    {
-        for(int j=0; j<MAP_VIEW_WIDTH; j++)
-        {
-            int map_y = map->viewpoint_y + i;
-            int map_x = map->viewpoint_x + j;
-
-            enum tile_t tile = map_get_tile(map, map_x, map_y);
-            const chtype color_character = tile_get_appearance(tile);
-
-            int display_x = j+2;
-            int display_y = i+1;
-
-            if(MAP_WIDTH<MAP_VIEW_WIDTH) display_x += (MAP_VIEW_WIDTH-MAP_WIDTH)/2;
-            if(MAP_HEIGHT<MAP_VIEW_HEIGHT) display_y += (MAP_VIEW_HEIGHT-MAP_HEIGHT)/2;
-
-            mvwaddch(window, display_y, display_x, color_character);
-        }
-    }
-
-    // Wyświetl ramke
-    for(int i=0; i<MAP_VIEW_WIDTH+2; i++)
-    {
-        mvwaddch(window, MAP_VIEW_HEIGHT+1, i, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
-        mvwaddch(window, 0, i, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
-    }
-    for(int i=0; i<MAP_VIEW_HEIGHT+2; i++)
-    {
-        mvwaddch(window, i, 0, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
-        mvwaddch(window, i, 1, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
-        mvwaddch(window, i, MAP_VIEW_WIDTH+2, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
-        mvwaddch(window, i, MAP_VIEW_WIDTH+3, ' '|COLOR_PAIR(COLOR_GREEN_ON_YELLOW));
-    }
-
-    // Wyświetla poziomy pasek przewijania
-    if(MAP_WIDTH>MAP_VIEW_WIDTH)
-    {
-        int viewpoint_max = MAP_WIDTH-MAP_VIEW_WIDTH;
-        int pos = map->viewpoint_x*(MAP_VIEW_WIDTH-3)/viewpoint_max+2;
-        mvwaddch(window, MAP_VIEW_HEIGHT+1, pos, ' '|COLOR_PAIR(COLOR_WHITE_ON_MAGENTA));
-        mvwaddch(window, MAP_VIEW_HEIGHT+1, pos+1, ' '|COLOR_PAIR(COLOR_WHITE_ON_MAGENTA));
-    }
-
-    // Wyświetla pionowy pasek przewijania
-    if(MAP_HEIGHT>MAP_VIEW_HEIGHT)
-    {
-        int viewpoint_max = MAP_HEIGHT-MAP_VIEW_HEIGHT;
-        int pos = map->viewpoint_y*(MAP_VIEW_HEIGHT-1)/viewpoint_max+1;
-        mvwaddch(window, pos, MAP_VIEW_WIDTH+2, ' '|COLOR_PAIR(COLOR_WHITE_ON_MAGENTA));
-        mvwaddch(window, pos, MAP_VIEW_WIDTH+3, ' '|COLOR_PAIR(COLOR_WHITE_ON_MAGENTA));
-    }
-
-    wrefresh(window);
+    memcpy(destination->tiles.data(), source->tiles.data(), source->tiles.size()*sizeof(enum tile_t));
 }
 
-// Kopiowanie mapy
-void map_copy(const struct map_t *source, struct map_t *destination)
+// Kopiowanie prostokątnego fragmentu mapy (przyciętego do jej granic) - obie mapy muszą mieć ten sam rozmiar
+void map_copy_area(const struct map_t *source, struct map_t *destination, int x, int y, int width, int height)
 {
-    for(int i=0; i<MAP_HEIGHT; i++)
+    int x_begin = x<0 ? 0 : x;
+    int y_begin = y<0 ? 0 : y;
+    int x_end = x+width>source->width ? source->width : x+width;
+    int y_end = y+height>source->height ? source->height : y+height;
+    if(x_begin>=x_end)
+        return;
+
+    for(int i=y_begin; i<y_end; i++)
     {
-        for(int j=0; j<MAP_WIDTH; j++)
+#ifdef MAP_LAYOUT_TILED
+        for(int j=x_begin; j<x_end; j++)
         {
-            destination->map[i][j] = source->map[i][j];
+            int index = map_index(source, j, i);
+            destination->tiles[index] = source->tiles[index];
         }
+#else
+        int begin = map_index(source, x_begin, i);
+        memcpy(&destination->tiles[begin], &source->tiles[begin], (x_end-x_begin)*sizeof(enum tile_t));
+#endif
     }
 }
 
-// Wypełnienie całej mapy podanym kafelkiem
+// Wypełnienie całej mapy podanym kafelkiem - bez ramki
 void map_fill(struct map_t *map, enum tile_t tile)
 {
-    for(int i=0; i<MAP_HEIGHT; i++)
+    for(int y=0; y<map->height; y++)
     {
-        for(int j=0; j<MAP_WIDTH; j++)
-            map->map[i][j] = tile;
+#ifdef MAP_LAYOUT_TILED
+        for(int x=0; x<map->width; x++)
+            map->tiles[map_index(map, x, y)] = tile;
+#else
+        memset(&map->tiles[map_index(map, 0, y)], tile, map->width*sizeof(enum tile_t));
+#endif
     }
 }
 
@@ -134,12 +113,16 @@ void map_update_with_surrounding_area(struct map_t *map, surrounding_area_t *are
 }
 
 // Usówa kafelki które mogły zmienić swoją pozycję
-void map_remove_unsure_tiles(struct map_t *map)
+// Takie kafelki pochodzą jedynie z ostatnio widzianego obszaru, więc przeglądane jest tylko otoczenie punktu (x, y)
+void map_remove_unsure_tiles(struct map_t *map, int x_center, int y_center)
 {
-    for(int y=0; y<MAP_HEIGHT; y++)
+    for(int y=y_center-VISIBLE_DISTANCE; y<=y_center+VISIBLE_DISTANCE; y++)
     {
-        for(int x=0; x<MAP_WIDTH; x++)
+        for(int x=x_center-VISIBLE_DISTANCE; x<=x_center+VISIBLE_DISTANCE; x++)
         {
+            if(x<0 || y<0 || x>=map->width || y>=map->height)
+                continue;
+
             enum tile_t tile = map_get_tile(map, x, y);
             if(!tile_is_sure(tile)) 
                 map_set_tile(map, x, y, TILE_FLOOR);
@@ -147,118 +130,166 @@ void map_remove_unsure_tiles(struct map_t *map)
     }
 }
 
-// Funkcja rekurencyjnego generowania labiryntu
-static void map_maze_recur(struct map_t *map, int x, int y)
+// Generuje labirynt - przeszukiwanie w głąb z nawrotami na własnym stosie, więc zużycie stosu nie zależy od rozmiaru mapy
+// Komórki labiryntu leżą na nieparzystych współrzędnych, a te dwa kafelki za krawędzią wypadają w ramce (TILE_VOID)
+void map_generate_maze(struct map_t *map, struct rng_t *rng)
 {
-    int unchecked[4] = { MAP_GEN_LEFT, MAP_GEN_RIGHT, MAP_GEN_UP, MAP_GEN_DOWN };
+    map_fill(map, TILE_WALL);
+
+    enum tile_t *tiles = map->tiles.data();
+    int stride = map->stride;
+    std::vector<int> stack;
 
-    for(int i=4; i>0; i--)
+    int start = map_index(map, 1, 1);
+    tiles[start] = TILE_FLOOR;
+    stack.push_back(start);
+
+    while(!stack.empty())
     {
-        int r = rand()%i;
-        int dir = unchecked[r];
-        unchecked[r] = unchecked[i-1];
+        int cell = stack.back();
 
-        int dirx, diry;
-        if(dir==MAP_GEN_UP)         { dirx=0;   diry=-1; }
-        else if(dir==MAP_GEN_DOWN)  { dirx=0;   diry=1;  }
-        else if(dir==MAP_GEN_LEFT)  { dirx=-1;  diry=0;  }
-        else if(dir==MAP_GEN_RIGHT) { dirx=1;   diry=0;  }
+        // Nieodwiedzone komórki sąsiednie i ściany oddzielające je od bieżącej
+        int passages[4];
+        int neighbours[4];
+        int count = 0;
+        for(int dir=0; dir<4; dir++)
+        {
+            int passage = map_neighbour_index(stride, cell, dir);
+            int neighbour = map_neighbour_index(stride, passage, dir);
+            if(tiles[neighbour]==TILE_WALL)
+            {
+                passages[count] = passage;
+                neighbours[count] = neighbour;
+                count++;
+            }
+        }
 
-        if(map_get_tile(map, x+dirx*2, y+diry*2)==TILE_WALL)
+        // Ślepy zaułek - powrót
+        if(count==0)
         {
-            map_set_tile(map, x+dirx*1, y+diry*1, TILE_FLOOR);
-            map_set_tile(map, x+dirx*2, y+diry*2, TILE_FLOOR);
-            map_maze_recur(map, x+dirx*2, y+diry*2);
+            stack.pop_back();
+            continue;
         }
-    }
-}
 
-// Generuje labirynt
-void map_generate_maze(struct map_t *map)
-{
-    map_fill(map, TILE_WALL);
-    map_maze_recur(map, 1, 1);
+        int chosen = rng_below(rng, count);
+        tiles[passages[chosen]] = TILE_FLOOR;
+        tiles[neighbours[chosen]] = TILE_FLOOR;
+        stack.push_back(neighbours[chosen]);
+    }
 }
 
 // Scrolluje mapę w podanych kierunkach (lub nie)
 void map_shift(struct map_t *map, int shift_x, int shift_y)
 {
-    if(MAP_WIDTH>MAP_VIEW_WIDTH)
+    if(map->width>MAP_VIEW_WIDTH)
     {
         map->viewpoint_x += shift_x;
         if(map->viewpoint_x<0)
             map->viewpoint_x = 0;
-        else if(map->viewpoint_x>MAP_WIDTH-MAP_VIEW_WIDTH)
-            map->viewpoint_x = MAP_WIDTH-MAP_VIEW_WIDTH;
+        else if(map->viewpoint_x>map->width-MAP_VIEW_WIDTH)
+            map->viewpoint_x = map->width-MAP_VIEW_WIDTH;
     }
 
-    if(MAP_HEIGHT>MAP_VIEW_HEIGHT)
+    if(map->height>MAP_VIEW_HEIGHT)
     {
         map->viewpoint_y += shift_y;
         if(map->viewpoint_y<0)
             map->viewpoint_y = 0;
-        else if(map->viewpoint_y>MAP_HEIGHT-MAP_VIEW_HEIGHT)
-            map->viewpoint_y = MAP_HEIGHT-MAP_VIEW_HEIGHT;
+        else if(map->viewpoint_y>map->height-MAP_VIEW_HEIGHT)
+            map->viewpoint_y = map->height-MAP_VIEW_HEIGHT;
     }
 }
 
-// Losuje wolny kafelek i zwraca jego pozycje (lub nie)
-int map_random_free_position(struct map_t *map, int *resx, int *resy)
+// Buduje od zera zbiór wolnych kafelków (TILE_FLOOR) mapy
+void map_free_cells_build(struct map_free_cells_t *free_cells, struct map_t *map)
 {
-    int good_pos = 0;
+    free_cells->width = map->width;
+    free_cells->height = map->height;
+    free_cells->cells.clear();
+    free_cells->positions.assign(map->width*map->height, -1);
 
-    for(int i=0; i<MAP_HEIGHT; i++)
+    for(int y=0; y<map->height; y++)
     {
-        for(int j=0; j<MAP_WIDTH; j++)
+        for(int x=0; x<map->width; x++)
         {
-            if(map_get_tile(map, j, i)==TILE_FLOOR)
-                good_pos++;
+            if(map_get_tile(map, x, y)==TILE_FLOOR)
+            {
+                int cell = y*map->width+x;
+                free_cells->positions[cell] = free_cells->cells.size();
+                free_cells->cells.push_back(cell);
+            }
         }
     }
+}
 
-    // Wolnego kafelka nie udało się znaleźć
-    if(good_pos==0) return 1;
+// Aktualizuje zbiór wolnych kafelków po zmianie kafelka w danym miejscu - dodanie i usunięcie w czasie stałym
+void map_free_cells_update(struct map_free_cells_t *free_cells, int x, int y, enum tile_t tile)
+{
+    if(free_cells->positions.empty() || x<0 || y<0 || x>=free_cells->width || y>=free_cells->height)
+        return;
 
-    int pos = rand()%good_pos;
+    int cell = y*free_cells->width+x;
+    int position = free_cells->positions[cell];
 
-    for(int i=0; i<MAP_HEIGHT; i++)
+    // Kafelek stał się wolny
+    if(tile==TILE_FLOOR && position==-1)
     {
-        for(int j=0; j<MAP_WIDTH; j++)
-        {
-            if(map_get_tile(map, j, i)==TILE_FLOOR)
-            {
-                if(pos==0)
-                {
-                    *resx = j;
-                    *resy = i;
-                    return 0;
-                }
-                pos--;
-            }
-        }
+        free_cells->positions[cell] = free_cells->cells.size();
+        free_cells->cells.push_back(cell);
+    }
+
+    // Kafelek przestał być wolny - na jego miejsce trafia ostatni z listy
+    else if(tile!=TILE_FLOOR && position!=-1)
+    {
+        int last = free_cells->cells.back();
+        free_cells->cells[position] = last;
+        free_cells->positions[last] = position;
+        free_cells->cells.pop_back();
+        free_cells->positions[cell] = -1;
     }
-    return 1;
+}
+
+// Losuje wolny kafelek i zwraca jego pozycje (lub nie)
+int map_random_free_position(struct map_free_cells_t *free_cells, struct rng_t *rng, int *resx, int *resy)
+{
+    int good_pos = free_cells->cells.size();
+
+    // Wolnego kafelka nie udało się znaleźć
+    if(good_pos==0) return 1;
+
+    int cell = free_cells->cells[rng_below(rng, good_pos)];
+    *resx = cell%free_cells->width;
+    *resy = cell/free_cells->width;
+    return 0;
 }
 
 // Dodaje do mapy krzaki
-static void map_add_bush(struct map_t *map)
+static void map_add_bush(struct map_t *map, struct map_free_cells_t *free_cells, struct rng_t *rng)
 {
-    int bush_count = MAP_WIDTH*MAP_HEIGHT/MAP_GEN_BUSH_FACTOR;
+    int bush_count = map->width*map->height/MAP_GEN_BUSH_FACTOR;
 
     for(int i=0; i<bush_count; i++)
     {
         int x = 0;
         int y = 0;
-        int res = map_random_free_position(map, &x, &y);
+        int res = map_random_free_position(free_cells, rng, &x, &y);
         if(res!=0) return;
         map_set_tile(map, x, y, TILE_BUSH);
+        map_free_cells_update(free_cells, x, y, TILE_BUSH);
     }
 }
 
-// Generuje mapę
-void map_generate_everything(struct map_t *map)
+// Generuje mapę - wynik zależy jedynie od rozmiaru mapy i stanu generatora
+void map_generate_everything(struct map_t *map, struct rng_t *rng)
 {
-    map_generate_maze(map);
-    map_random_free_position(map, &map->campside_x, &map->campside_y);
-    map_add_bush(map);
+    struct map_free_cells_t free_cells;
+
+    map_generate_maze(map, rng);
+    map_free_cells_build(&free_cells, map);
+
+    // Obozowisko nie jest częścią tła, ale krzaki nie mogą na nim wyrosnąć
+    map_random_free_position(&free_cells, rng, &map->campside_x, &map->campside_y);
+    map_free_cells_update(&free_cells, map->campside_x, map->campside_y, TILE_CAMPSIDE);
+
+    map_add_bush(map, &free_cells, rng);
 }
\ No newline at end of file
@@ -2,17 +2,12 @@
 #define __MAP_H__
 
 #include <stdint.h>
-#include <ncursesw/ncurses.h>
+#include <vector>
 #include "common.h"
+#include "rng.h"
 #include "tiles.h"
 
-// Stałe używane przy generacji labiryntu
-#define MAP_GEN_UP 0
-#define MAP_GEN_DOWN 1
-#define MAP_GEN_LEFT 2
-#define MAP_GEN_RIGHT 3
-
-// Współczynniki mówiące o liczbe danych przedmiotów na mapie count=MAP_WIDTH*MAP_HEIGHT/FACTOR
+// Współczynniki mówiące o liczbe danych przedmiotów na mapie count=width*height/FACTOR
 #define MAP_GEN_BUSH_FACTOR 20
 #define MAP_GEN_COIN_FACTOR 80
 #define MAP_GEN_TREASURE_S_FACTOR 80
@@ -20,6 +15,22 @@
 #define MAP_GEN_BEAST_FACTOR 300
 #define MAP_GEN_HOLES_FACTOR 50
 
+// Szerokość ramki z kafelków TILE_VOID otaczającej mapę - sąsiedztwa sięgające do niej czytane są bez sprawdzania granic
+#define MAP_BORDER VISIBLE_DISTANCE
+
+// Układ kafelków w pamięci - domyślnie wierszami, z MAP_LAYOUT_TILED kwadratowymi blokami MAP_BLOCK_SIZE x MAP_BLOCK_SIZE
+// (jeden blok to jedna linia pamięci podręcznej), dzięki czemu sąsiedzi w pionie zwykle leżą w tej samej linii
+#define MAP_BLOCK_SHIFT 3
+#define MAP_BLOCK_SIZE (1<<MAP_BLOCK_SHIFT)
+#define MAP_BLOCK_MASK (MAP_BLOCK_SIZE-1)
+#define MAP_BLOCK_AREA (MAP_BLOCK_SIZE*MAP_BLOCK_SIZE)
+
+// Kierunki sąsiadów dla map_neighbour_index
+#define MAP_DIR_LEFT 0
+#define MAP_DIR_RIGHT 1
+#define MAP_DIR_UP 2
+#define MAP_DIR_DOWN 3
+
 // Mapa
 struct map_t
 {
@@ -29,20 +40,108 @@ struct map_t
     int campside_x;
     int campside_y;
 
-    enum tile_t map[MAP_HEIGHT][MAP_WIDTH];
+    // Rozmiar ustalany przez map_init
+    int width;
+    int height;
+
+    // Kafelki razem z ramką - wiersz z ramką ma stride=width+2*MAP_BORDER kafelków, położenie kafelka wyznacza map_index
+    int stride;
+    std::vector<enum tile_t> tiles;
+};
+
+// Zbiór wolnych kafelków (TILE_FLOOR) - komórki numerowane y*width+x
+struct map_free_cells_t
+{
+    // Lista wolnych komórek w dowolnej kolejności
+    std::vector<int> cells;
+
+    // Pozycja komórki na liście lub -1 gdy nie jest wolna
+    std::vector<int> positions;
+
+    // Rozmiar mapy, z której zbiór został zbudowany
+    int width;
+    int height;
 };
 
+// Indeks kafelka (x, y) w tablicy z ramką o danej szerokości wiersza - także dla tablic równoległych do mapy
+inline int map_layout_index(int stride, int x, int y)
+{
+    int px = x+MAP_BORDER;
+    int py = y+MAP_BORDER;
+#ifdef MAP_LAYOUT_TILED
+    int blocks_per_row = (stride+MAP_BLOCK_MASK)>>MAP_BLOCK_SHIFT;
+    int block = (py>>MAP_BLOCK_SHIFT)*blocks_per_row+(px>>MAP_BLOCK_SHIFT);
+    return block*MAP_BLOCK_AREA+((py&MAP_BLOCK_MASK)<<MAP_BLOCK_SHIFT)+(px&MAP_BLOCK_MASK);
+#else
+    return py*stride+px;
+#endif
+}
+
+// Liczba komórek tablicy z ramką dla mapy danego rozmiaru
+inline int map_layout_size(int width, int height)
+{
+    int stride = width+2*MAP_BORDER;
+    int rows = height+2*MAP_BORDER;
+#ifdef MAP_LAYOUT_TILED
+    int blocks_per_row = (stride+MAP_BLOCK_MASK)>>MAP_BLOCK_SHIFT;
+    int blocks_per_column = (rows+MAP_BLOCK_MASK)>>MAP_BLOCK_SHIFT;
+    return blocks_per_row*blocks_per_column*MAP_BLOCK_AREA;
+#else
+    return stride*rows;
+#endif
+}
+
+// Indeks sąsiada komórki o danym indeksie - bez przeliczania współrzędnych, sąsiad nie może wychodzić poza ramkę
+inline int map_neighbour_index(int stride, int index, int dir)
+{
+#ifdef MAP_LAYOUT_TILED
+    int row_step = ((stride+MAP_BLOCK_MASK)>>MAP_BLOCK_SHIFT)*MAP_BLOCK_AREA;
+    int column = index&MAP_BLOCK_MASK;
+    int row = (index>>MAP_BLOCK_SHIFT)&MAP_BLOCK_MASK;
+    if(dir==MAP_DIR_LEFT)
+        return column!=0 ? index-1 : index-MAP_BLOCK_AREA+MAP_BLOCK_MASK;
+    if(dir==MAP_DIR_RIGHT)
+        return column!=MAP_BLOCK_MASK ? index+1 : index+MAP_BLOCK_AREA-MAP_BLOCK_MASK;
+    if(dir==MAP_DIR_UP)
+        return row!=0 ? index-MAP_BLOCK_SIZE : index-row_step+MAP_BLOCK_AREA-MAP_BLOCK_SIZE;
+    return row!=MAP_BLOCK_MASK ? index+MAP_BLOCK_SIZE : index+row_step-MAP_BLOCK_AREA+MAP_BLOCK_SIZE;
+#else
+    if(dir==MAP_DIR_LEFT)
+        return index-1;
+    if(dir==MAP_DIR_RIGHT)
+        return index+1;
+    if(dir==MAP_DIR_UP)
+        return index-stride;
+    return index+stride;
+#endif
+}
+
+// Indeks kafelka (x, y) w tablicy z ramką
+inline int map_index(const struct map_t *map, int x, int y)
+{
+    return map_layout_index(map->stride, x, y);
+}
+
+// Odczyt kafelka bez sprawdzania granic - poprawny dla współrzędnych najwyżej MAP_BORDER poza mapą
+inline enum tile_t map_tile_at(const struct map_t *map, int x, int y)
+{
+    return map->tiles[map_index(map, x, y)];
+}
+
 // Prototypy
-void map_display(struct map_t *map, WINDOW *window);
+void map_init(struct map_t *map, int width, int height);
 enum tile_t map_get_tile(struct map_t *map, int x, int y);
 void map_set_tile(struct map_t *map, int x, int y, enum tile_t tile);
 void map_copy(const struct map_t *source, struct map_t *destination);
+void map_copy_area(const struct map_t *source, struct map_t *destination, int x, int y, int width, int height);
 void map_fill(struct map_t *map, enum tile_t tile);
 void map_update_with_surrounding_area(struct map_t *map, surrounding_area_t *area, int x, int y);
-void map_remove_unsure_tiles(struct map_t *map);
-void map_generate_maze(struct map_t *map);
+void map_remove_unsure_tiles(struct map_t *map, int x, int y);
+void map_generate_maze(struct map_t *map, struct rng_t *rng);
 void map_shift(struct map_t *map, int shift_x, int shift_y);
-int map_random_free_position(struct map_t *map, int *resx, int *resy);
-void map_generate_everything(struct map_t *map);
+void map_free_cells_build(struct map_free_cells_t *free_cells, struct map_t *map);
+void map_free_cells_update(struct map_free_cells_t *free_cells, int x, int y, enum tile_t tile);
+int map_random_free_position(struct map_free_cells_t *free_cells, struct rng_t *rng, int *resx, int *resy);
+void map_generate_everything(struct map_t *map, struct rng_t *rng);
 
 #endif
\ No newline at end of file
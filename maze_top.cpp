@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "stats.h"
+
+// Domyślny odstęp między odświeżeniami w sekundach
+#define TOP_DEFAULT_DELAY 1.0
+
+// Funkcje statyczne
+static void top_print(struct stats_block_t *current, struct stats_block_t *previous, int clear);
+
+// Wypisanie statystyk - percentyle od startu serwera oraz p99 z ostatniego odstępu między odświeżeniami
+static void top_print(struct stats_block_t *current, struct stats_block_t *previous, int clear)
+{
+    if(clear)
+        printf("\033[H\033[2J");
+
+    printf("server pid=%d tick=%u round=%d players=%d beasts=%d overruns=%lld\n\n", current->server_pid, current->tick,
+        current->round, current->players, current->beasts, current->overruns);
+    printf("%-18s %10s %10s %10s %10s %10s %12s\n", "phase", "samples", "p50 us", "p99 us", "max us", "mean us", "recent p99");
+
+    for(int i=0; i<STATS_PHASES_COUNT; i++)
+    {
+        struct stats_histogram_t *histogram = current->phases+i;
+        if(histogram->count==0)
+        {
+            printf("%-18s %10d %10s %10s %10s %10s %12s\n", stats_phase_names[i], 0, "-", "-", "-", "-", "-");
+            continue;
+        }
+
+        static struct stats_histogram_t recent;
+        stats_histogram_subtract(&recent, histogram, previous->phases+i);
+
+        printf("%-18s %10llu %10.1f %10.1f %10.1f %10.1f ", stats_phase_names[i], (unsigned long long)histogram->count,
+            stats_histogram_percentile(histogram, 0.5)/1000.0, stats_histogram_percentile(histogram, 0.99)/1000.0,
+            histogram->max_ns/1000.0, (double)histogram->sum_ns/histogram->count/1000.0);
+        if(recent.count>0)
+            printf("%12.1f\n", stats_histogram_percentile(&recent, 0.99)/1000.0);
+        else
+            printf("%12s\n", "-");
+    }
+
+    printf("\n");
+    for(int i=0; i<STATS_COUNTERS_COUNT; i++)
+        printf("%s=%llu%s", stats_counter_names[i], (unsigned long long)current->counters[i], i+1<STATS_COUNTERS_COUNT ? " " : "\n");
+    fflush(stdout);
+}
+
+// Czytnik statystyk działającego serwera - dołącza do pamięci współdzielonej tylko do odczytu
+int main(int argc, char **argv)
+{
+    double delay = TOP_DEFAULT_DELAY;
+    int iterations = 0;
+
+    int opt;
+    while((opt = getopt(argc, argv, "d:n:")) != -1)
+    {
+        if(opt=='d' && atof(optarg)>0)
+            delay = atof(optarg);
+        else if(opt=='n' && atoi(optarg)>0)
+            iterations = atoi(optarg);
+        else
+        {
+            fprintf(stderr, "Usage: %s [-d seconds] [-n iterations]\n"
+                "  -d  delay between refreshes (default %.0f s)\n"
+                "  -n  stop after this many refreshes (default: run until the server exits)\n", argv[0], TOP_DEFAULT_DELAY);
+            return 1;
+        }
+    }
+
+    int fd = shm_open(STATS_SHM_FILE_NAME, O_RDONLY, 0);
+    check(fd!=-1, "cannot open server stats, is the server running?");
+
+    struct stat st;
+    check(fstat(fd, &st)==0 && st.st_size>=(off_t)sizeof(struct stats_block_t), "server stats have unexpected size");
+
+    struct stats_block_t *block = (struct stats_block_t *)mmap(NULL, sizeof(struct stats_block_t), PROT_READ, MAP_SHARED, fd, 0);
+    check(block!=MAP_FAILED, "mmap error");
+
+    // Dwie kopie bloku - bieżąca i z poprzedniego odświeżenia, przed pierwszym odświeżeniem pusta
+    static struct stats_block_t copies[2];
+    int current = 0;
+
+    int status = 0;
+    int clear = isatty(STDOUT_FILENO) && iterations!=1;
+    for(int i=0; iterations==0 || i<iterations; i++)
+    {
+        if(i>0)
+            usleep((useconds_t)(delay*1e6));
+
+        if(!stats_read(block, copies+current))
+        {
+            printf("server not responding\n");
+            status = 1;
+            break;
+        }
+        check(copies[current].version==STATS_VERSION, "server stats have unsupported version");
+        top_print(copies+current, copies+1-current, clear);
+        current = 1-current;
+
+        if(kill(copies[1-current].server_pid, 0)!=0)
+        {
+            printf("server exited\n");
+            break;
+        }
+    }
+
+    munmap(block, sizeof(struct stats_block_t));
+    close(fd);
+    return status;
+}
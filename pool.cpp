@@ -0,0 +1,124 @@
+#include <pthread.h>
+#include "common.h"
+#include "pool.h"
+
+// Funkcje statyczne
+static void *pool_worker_thread(void *ptr);
+static void pool_work(struct worker_pool_t *pool);
+
+// Wykonywanie kolejnych porcji bieżącego zadania, dopóki są jakieś do pobrania
+static void pool_work(struct worker_pool_t *pool)
+{
+    while(1)
+    {
+        int begin = __atomic_fetch_add(&pool->next_item, POOL_CHUNK_SIZE, __ATOMIC_RELAXED);
+        if(begin>=pool->items_count)
+            return;
+
+        int end = begin+POOL_CHUNK_SIZE;
+        if(end>pool->items_count)
+            end = pool->items_count;
+        pool->task(pool->arg, begin, end);
+    }
+}
+
+// Wątek roboczy - czeka na nowe zadanie, pomaga je wykonać i zgłasza koniec
+static void *pool_worker_thread(void *ptr)
+{
+    struct worker_pool_t *pool = (struct worker_pool_t *)ptr;
+    unsigned seen_generation = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    while(1)
+    {
+        while(!pool->stop && pool->generation==seen_generation)
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+        if(pool->stop)
+            break;
+        seen_generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        pool_work(pool);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->busy_workers--;
+        if(pool->busy_workers==0)
+            pthread_cond_signal(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+// Uruchomienie puli - threads_count to łączna liczba wątków razem z wywołującym, więc 1 oznacza brak wątków roboczych
+void pool_init(struct worker_pool_t *pool, int threads_count)
+{
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    pool->task = NULL;
+    pool->arg = NULL;
+    pool->items_count = 0;
+    pool->next_item = 0;
+    pool->generation = 0;
+    pool->busy_workers = 0;
+    pool->stop = 0;
+
+    pool->threads.resize(threads_count>1 ? threads_count-1 : 0);
+    for(int i=0; i<(int)pool->threads.size(); i++)
+    {
+        int res = pthread_create(&pool->threads[i], NULL, pool_worker_thread, pool);
+        check(res==0, "pthread_create error");
+    }
+}
+
+// Zatrzymanie i zwolnienie wątków roboczych
+void pool_destroy(struct worker_pool_t *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for(int i=0; i<(int)pool->threads.size(); i++)
+        pthread_join(pool->threads[i], NULL);
+    pool->threads.clear();
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+// Łączna liczba wątków wykonujących zadania, razem z wywołującym
+int pool_threads_count(struct worker_pool_t *pool)
+{
+    return pool->threads.size()+1;
+}
+
+// Wykonanie zadania dla elementów [0, items_count) - wraca dopiero gdy wszystkie zostały przetworzone
+void pool_run(struct worker_pool_t *pool, int items_count, pool_task_t task, void *arg)
+{
+    if(pool->threads.empty())
+    {
+        if(items_count>0)
+            task(arg, 0, items_count);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->arg = arg;
+    pool->items_count = items_count;
+    pool->next_item = 0;
+    pool->busy_workers = pool->threads.size();
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    pool_work(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    while(pool->busy_workers>0)
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,39 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <pthread.h>
+#include <vector>
+
+// Liczba elementów pobieranych przez wątek za jednym razem
+#define POOL_CHUNK_SIZE 64
+
+// Zadanie wykonywane dla przedziału elementów [begin, end)
+typedef void (*pool_task_t)(void *arg, int begin, int end);
+
+// Pula wątków roboczych - wątek wywołujący pool_run pracuje razem z nimi i czeka na koniec zadania
+struct worker_pool_t
+{
+    std::vector<pthread_t> threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    // Bieżące zadanie
+    pool_task_t task;
+    void *arg;
+    int items_count;
+    int next_item;
+
+    // Numer zadania - zmiana budzi wątki, oraz liczba wątków jeszcze pracujących nad zadaniem
+    unsigned generation;
+    int busy_workers;
+    int stop;
+};
+
+// Prototypy
+void pool_init(struct worker_pool_t *pool, int threads_count);
+void pool_destroy(struct worker_pool_t *pool);
+int pool_threads_count(struct worker_pool_t *pool);
+void pool_run(struct worker_pool_t *pool, int items_count, pool_task_t task, void *arg);
+
+#endif
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "replay.h"
+#include "common.h"
+#include "map.h"
+#include "pool.h"
+#include "server_data.h"
+#include "tiles.h"
+
+// Rozmiar bufora zapisu dziennika
+#define REPLAY_BUFFER_SIZE (1<<16)
+
+// Funkcje statyczne
+static void replay_write(struct replay_log_t *log, const void *data, size_t size);
+static int replay_read(FILE *file, void *data, size_t size);
+static void replay_write_header(struct replay_log_t *log, struct replay_header_t *header);
+static int replay_read_header(FILE *file, struct replay_header_t *header);
+static void replay_finish_tick(struct server_data_t *sd, struct client_output_block_t *output);
+
+// Dane serwera odtwarzanej rozgrywki
+static struct server_data_t replay_data;
+
+// Zapisanie danych do dziennika - błąd zapisu kończy serwer, bo dziennik bez części tur jest bezużyteczny
+static void replay_write(struct replay_log_t *log, const void *data, size_t size)
+{
+    check(fwrite(data, 1, size, log->file)==size, "replay log write error");
+}
+
+// Odczytanie danych z dziennika - 0 gdy dziennik się skończył
+static int replay_read(FILE *file, void *data, size_t size)
+{
+    return fread(data, 1, size, file)==size;
+}
+
+// Nagłówek zapisywany pole po polu - bez wyrównania struktury
+static void replay_write_header(struct replay_log_t *log, struct replay_header_t *header)
+{
+    replay_write(log, &header->magic, sizeof(header->magic));
+    replay_write(log, &header->version, sizeof(header->version));
+    replay_write(log, &header->seed, sizeof(header->seed));
+    replay_write(log, &header->capacity, sizeof(header->capacity));
+    replay_write(log, &header->map_width, sizeof(header->map_width));
+    replay_write(log, &header->map_height, sizeof(header->map_height));
+}
+
+static int replay_read_header(FILE *file, struct replay_header_t *header)
+{
+    return replay_read(file, &header->magic, sizeof(header->magic))
+        && replay_read(file, &header->version, sizeof(header->version))
+        && replay_read(file, &header->seed, sizeof(header->seed))
+        && replay_read(file, &header->capacity, sizeof(header->capacity))
+        && replay_read(file, &header->map_width, sizeof(header->map_width))
+        && replay_read(file, &header->map_height, sizeof(header->map_height));
+}
+
+// Rozpoczęcie zapisu dziennika - wywoływane po sd_init, zanim runda zostanie wygenerowana
+void replay_log_open(struct replay_log_t *log, const char *path, struct server_data_t *sd)
+{
+    log->file = fopen(path, "wb");
+    check(log->file!=NULL, "cannot open replay log");
+    setvbuf(log->file, NULL, _IOFBF, REPLAY_BUFFER_SIZE);
+
+    struct replay_header_t header;
+    header.magic = REPLAY_MAGIC;
+    header.version = REPLAY_VERSION;
+    header.seed = sd->seed;
+    header.capacity = sd->clients_data.size();
+    header.map_width = sd->map.width;
+    header.map_height = sd->map.height;
+    replay_write_header(log, &header);
+}
+
+// Zakończenie zapisu dziennika
+void replay_log_close(struct replay_log_t *log)
+{
+    if(log->file==NULL)
+        return;
+    fclose(log->file);
+    log->file = NULL;
+}
+
+// Początek tury
+void replay_log_tick_begin(struct replay_log_t *log)
+{
+    if(log->file==NULL)
+        return;
+    uint8_t event = REPLAY_EVENT_TICK_BEGIN;
+    replay_write(log, &event, sizeof(event));
+}
+
+// Koniec tury - dziennik jest opróżniany, więc po awarii serwera traci się najwyżej bieżącą turę
+void replay_log_tick_end(struct replay_log_t *log, struct server_data_t *sd)
+{
+    if(log->file==NULL)
+        return;
+    uint8_t record[1+sizeof(uint64_t)];
+    uint64_t hash = sd_state_hash(sd);
+    record[0] = REPLAY_EVENT_TICK_END;
+    memcpy(record+1, &hash, sizeof(hash));
+    replay_write(log, record, sizeof(record));
+    fflush(log->file);
+}
+
+// Akcja gracza przekazana do sd_move
+void replay_log_move(struct replay_log_t *log, int slot, enum action_t action)
+{
+    if(log->file==NULL)
+        return;
+    uint8_t record[4];
+    uint16_t slot16 = slot;
+    record[0] = REPLAY_EVENT_MOVE;
+    memcpy(record+1, &slot16, sizeof(slot16));
+    record[3] = action;
+    replay_write(log, record, sizeof(record));
+}
+
+// Dołączenie klienta
+void replay_log_join(struct replay_log_t *log, int slot, int pid, enum client_type_t type)
+{
+    if(log->file==NULL)
+        return;
+    uint8_t record[8];
+    uint16_t slot16 = slot;
+    int32_t pid32 = pid;
+    record[0] = REPLAY_EVENT_JOIN;
+    memcpy(record+1, &slot16, sizeof(slot16));
+    record[3] = type;
+    memcpy(record+4, &pid32, sizeof(pid32));
+    replay_write(log, record, sizeof(record));
+}
+
+// Usunięcie klienta
+void replay_log_leave(struct replay_log_t *log, int slot)
+{
+    if(log->file==NULL)
+        return;
+    uint8_t record[3];
+    uint16_t slot16 = slot;
+    record[0] = REPLAY_EVENT_LEAVE;
+    memcpy(record+1, &slot16, sizeof(slot16));
+    replay_write(log, record, sizeof(record));
+}
+
+// Dodanie bestii przez administratora
+void replay_log_add_beast(struct replay_log_t *log)
+{
+    if(log->file==NULL)
+        return;
+    uint8_t event = REPLAY_EVENT_ADD_BEAST;
+    replay_write(log, &event, sizeof(event));
+}
+
+// Dodanie monety lub skarbu przez administratora
+void replay_log_add_item(struct replay_log_t *log, enum tile_t tile)
+{
+    if(log->file==NULL)
+        return;
+    uint8_t record[2];
+    record[0] = REPLAY_EVENT_ADD_ITEM;
+    record[1] = tile;
+    replay_write(log, record, sizeof(record));
+}
+
+// Druga część tury - ta sama kolejność co w wątku aktualizującym serwera, wraz z wypełnianiem bloków wyjściowych
+static void replay_finish_tick(struct server_data_t *sd, struct client_output_block_t *output)
+{
+    sd_update_beasts(sd);
+
+    for(int k=0; k<(int)sd->active_slots.size(); k++)
+    {
+        int i = sd->active_slots[k];
+        if(sd->clients_data[i].type!=CLIENT_TYPE_FREE)
+            sd_fill_output_block(sd, i, &sd->complete_map, output);
+    }
+
+    if(sd_is_everything_colected(sd))
+        sd_next_round(sd);
+}
+
+// Odtworzenie rozgrywki z dziennika bez czekania na kolejne tury i bez klientów
+// Po każdej turze suma kontrolna stanu porównywana jest z zapisaną - odtwarzanie kończy się na pierwszej turze, w której przebiegi się rozeszły
+void replay_run(const char *path, struct worker_pool_t *pool, struct replay_result_t *result)
+{
+    FILE *file = fopen(path, "rb");
+    check(file!=NULL, "cannot open replay log");
+    setvbuf(file, NULL, _IOFBF, REPLAY_BUFFER_SIZE);
+
+    struct replay_header_t *header = &result->header;
+    check(replay_read_header(file, header), "replay log is too short");
+    check(header->magic==REPLAY_MAGIC, "not a replay log");
+    check(header->version==REPLAY_VERSION, "unsupported replay log version");
+    check(header->capacity>0 && header->capacity<=MAX_CLIENTS_COUNT, "replay log has invalid capacity");
+    check(header->map_width%2==1 && header->map_height%2==1 && header->map_width>=MAP_MIN_SIZE && header->map_height>=MAP_MIN_SIZE
+        && header->map_width<=MAP_MAX_SIZE && header->map_height<=MAP_MAX_SIZE, "replay log has invalid map size");
+
+    result->ticks = 0;
+    result->events = 0;
+    result->first_mismatch_tick = -1;
+
+    struct server_data_t *sd = &replay_data;
+    sd_init(sd, header->capacity, header->map_width, header->map_height, header->seed);
+    sd->pool = pool;
+    sd_next_round(sd);
+
+    // Mierzony jest tylko czas tur - bez wygenerowania pierwszej rundy
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    struct client_output_block_t output;
+    uint8_t event;
+    while(replay_read(file, &event, sizeof(event)))
+    {
+        uint16_t slot = 0;
+        uint8_t value = 0;
+        int32_t pid = 0;
+        uint64_t hash = 0;
+
+        // Urwany ostatni rekord - serwer przerwał zapis w trakcie tury
+        int complete = 1;
+        if(event==REPLAY_EVENT_MOVE)
+            complete = replay_read(file, &slot, sizeof(slot)) && replay_read(file, &value, sizeof(value));
+        else if(event==REPLAY_EVENT_JOIN)
+            complete = replay_read(file, &slot, sizeof(slot)) && replay_read(file, &value, sizeof(value)) && replay_read(file, &pid, sizeof(pid));
+        else if(event==REPLAY_EVENT_LEAVE)
+            complete = replay_read(file, &slot, sizeof(slot));
+        else if(event==REPLAY_EVENT_TICK_END)
+            complete = replay_read(file, &hash, sizeof(hash));
+        else if(event==REPLAY_EVENT_ADD_ITEM)
+            complete = replay_read(file, &value, sizeof(value));
+        if(!complete)
+            break;
+
+        check(slot<header->capacity, "replay log refers to a slot out of range");
+        result->events++;
+
+        if(event==REPLAY_EVENT_TICK_BEGIN)
+            sd->tick++;
+        else if(event==REPLAY_EVENT_MOVE)
+            sd_move(sd, slot, (enum action_t)value);
+        else if(event==REPLAY_EVENT_JOIN)
+            sd_add_client(sd, slot, pid, (enum client_type_t)value);
+        else if(event==REPLAY_EVENT_LEAVE)
+            sd_remove_client(sd, slot);
+        else if(event==REPLAY_EVENT_ADD_BEAST)
+            sd_add_beast(sd);
+        else if(event==REPLAY_EVENT_ADD_ITEM)
+            sd_add_something(sd, (enum tile_t)value);
+        else if(event==REPLAY_EVENT_TICK_END)
+        {
+            replay_finish_tick(sd, &output);
+            result->ticks++;
+            if(sd_state_hash(sd)!=hash)
+            {
+                result->first_mismatch_tick = sd->tick;
+                break;
+            }
+        }
+        else
+            check(0, "replay log is corrupted");
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    result->elapsed_ns = (end.tv_sec-start.tv_sec)*1000000000LL+(end.tv_nsec-start.tv_nsec);
+    result->final_hash = sd_state_hash(sd);
+    fclose(file);
+}
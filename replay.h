@@ -0,0 +1,81 @@
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "common.h"
+#include "pool.h"
+#include "server_data.h"
+#include "tiles.h"
+
+// Znacznik i wersja formatu dziennika wejścia
+#define REPLAY_MAGIC 0x474c5a4d
+#define REPLAY_VERSION 2
+
+// Rodzaje zdarzeń w dzienniku - każde zdarzenie to bajt rodzaju i stała dla danego rodzaju liczba bajtów danych,
+// liczby zapisywane są w kolejności bajtów maszyny, na której działał serwer
+enum replay_event_t : uint8_t
+{
+    // Początek tury - bez danych
+    REPLAY_EVENT_TICK_BEGIN = 1,
+
+    // Akcja przekazana do sd_move - slot(2), akcja(1)
+    REPLAY_EVENT_MOVE       = 2,
+
+    // Dołączenie klienta - slot(2), typ klienta(1), pid(4)
+    REPLAY_EVENT_JOIN       = 3,
+
+    // Usunięcie klienta - slot(2)
+    REPLAY_EVENT_LEAVE      = 4,
+
+    // Koniec tury po ruchu bestii i ewentualnej zmianie rundy - suma kontrolna stanu(8)
+    REPLAY_EVENT_TICK_END   = 5,
+
+    // Polecenia administratora z klawiatury serwera - bestia bez danych, moneta lub skarb z kafelkiem(1)
+    REPLAY_EVENT_ADD_BEAST  = 6,
+    REPLAY_EVENT_ADD_ITEM   = 7
+};
+
+// Nagłówek dziennika - wszystko czego potrzeba do odtworzenia stanu początkowego
+struct replay_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seed;
+    int32_t capacity;
+    int32_t map_width;
+    int32_t map_height;
+};
+
+// Dziennik zapisywany przez serwer - przy file równym NULL zapisywanie jest wyłączone
+struct replay_log_t
+{
+    FILE *file;
+};
+
+// Wynik odtworzenia rozgrywki
+struct replay_result_t
+{
+    struct replay_header_t header;
+    long long ticks;
+    long long events;
+    long long elapsed_ns;
+
+    // Pierwsza tura, po której suma kontrolna stanu różni się od zapisanej, -1 gdy żadna
+    long long first_mismatch_tick;
+    uint64_t final_hash;
+};
+
+// Prototypy
+void replay_log_open(struct replay_log_t *log, const char *path, struct server_data_t *sd);
+void replay_log_close(struct replay_log_t *log);
+void replay_log_tick_begin(struct replay_log_t *log);
+void replay_log_tick_end(struct replay_log_t *log, struct server_data_t *sd);
+void replay_log_move(struct replay_log_t *log, int slot, enum action_t action);
+void replay_log_join(struct replay_log_t *log, int slot, int pid, enum client_type_t type);
+void replay_log_leave(struct replay_log_t *log, int slot);
+void replay_log_add_beast(struct replay_log_t *log);
+void replay_log_add_item(struct replay_log_t *log, enum tile_t tile);
+void replay_run(const char *path, struct worker_pool_t *pool, struct replay_result_t *result);
+
+#endif
@@ -0,0 +1,57 @@
+#include <stdint.h>
+#include "rng.h"
+
+// Obrót bitów w lewo
+static inline uint64_t rng_rotl(uint64_t x, int k)
+{
+    return (x<<k) | (x>>(64-k));
+}
+
+// Kolejna wartość generatora splitmix64 - służy do rozwinięcia ziarna w pełny stan
+uint64_t rng_splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z^(z>>30))*0xbf58476d1ce4e5b9ULL;
+    z = (z^(z>>27))*0x94d049bb133111ebULL;
+    return z^(z>>31);
+}
+
+// Ustawienie stanu na podstawie ziarna - to samo ziarno daje zawsze ten sam ciąg
+void rng_seed(struct rng_t *rng, uint64_t seed)
+{
+    uint64_t splitmix_state = seed;
+    for(int i=0; i<4; i++)
+        rng->state[i] = rng_splitmix64(&splitmix_state);
+}
+
+// Ustawienie stanu strumienia o danym numerze - ziarno jest najpierw mieszane, więc sąsiednie ziarna i numery
+// strumieni nie dają przesuniętych kopii tego samego ciągu
+void rng_seed_stream(struct rng_t *rng, uint64_t seed, enum rng_stream_t stream)
+{
+    uint64_t splitmix_state = seed;
+    uint64_t mixed = rng_splitmix64(&splitmix_state)+(uint64_t)stream*0xd1b54a32d192ed03ULL;
+    rng_seed(rng, mixed);
+}
+
+// Kolejna 64-bitowa liczba losowa
+uint64_t rng_next(struct rng_t *rng)
+{
+    uint64_t *s = rng->state;
+    uint64_t result = rng_rotl(s[1]*5, 7)*9;
+    uint64_t t = s[1]<<17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+
+    return result;
+}
+
+// Liczba losowa z przedziału [0, bound) - mnożenie zamiast dzielenia modulo, obciążenie pomijalne dla małych bound
+uint32_t rng_below(struct rng_t *rng, uint32_t bound)
+{
+    return (uint32_t)(((rng_next(rng)>>32)*(uint64_t)bound)>>32);
+}
@@ -0,0 +1,30 @@
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include <stdint.h>
+
+// Generator liczb pseudolosowych xoshiro256** - stan jest zwykłą wartością, więc każdy wątek i podsystem może mieć własny
+struct rng_t
+{
+    uint64_t state[4];
+};
+
+// Niezależne strumienie losowań wyprowadzane z jednego ziarna rozgrywki - każdy podsystem losuje ze swojego,
+// więc losowania w jednym nie przesuwają ciągów pozostałych
+enum rng_stream_t
+{
+    RNG_STREAM_MAZE           = 1,
+    RNG_STREAM_ROUND_ENTITIES = 2,
+    RNG_STREAM_ENTITIES       = 3,
+    RNG_STREAM_BEASTS         = 4,
+    RNG_STREAM_BOT            = 5
+};
+
+// Prototypy
+uint64_t rng_splitmix64(uint64_t *state);
+void rng_seed(struct rng_t *rng, uint64_t seed);
+void rng_seed_stream(struct rng_t *rng, uint64_t seed, enum rng_stream_t stream);
+uint64_t rng_next(struct rng_t *rng);
+uint32_t rng_below(struct rng_t *rng, uint32_t bound);
+
+#endif
@@ -9,15 +9,29 @@
 #include <locale.h>
 #include <time.h>
 #include <stdlib.h>
+#include <signal.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/syscall.h>
 #include <ncursesw/ncurses.h>
+#include <vector>
+#include <utility>
 #include "common.h"
+#include "display.h"
+#include "pool.h"
+#include "replay.h"
 #include "server_data.h"
+#include "stats.h"
+#include "tick.h"
 #include "tiles.h"
 
 // Szerokość i wysokość panelu z logami
 #define LOG_LINES_COUNT 7
 #define LOG_LINE_WIDTH 35
 
+// Czas wyświetlania jednej klatki - niezależny od czasu trwania tury
+#define DISPLAY_FRAME_TIME 33333
+
 // O ile jednorazowo przesówa się mapa przy pciskaniu strzałem
 #define MAP_SHIFT_JUMP_X 1
 #define MAP_SHIFT_JUMP_Y 1
@@ -28,21 +42,82 @@
     for(int i=LOG_LINES_COUNT-1; i>0; i--)\
         strncpy(logs[i], logs[i-1], LOG_LINE_WIDTH);\
     snprintf(logs[0], LOG_LINE_WIDTH, __msg, ## __args);\
+    if(headless)\
+    {\
+        printf("%s\n", logs[0]);\
+        fflush(stdout);\
+    }\
 }
 
+// Migawka stanu serwera - wszystko czego potrzebuje wątek wyświetlający
+struct server_snapshot_t
+{
+    int server_pid;
+    int round;
+
+    std::vector<struct server_client_data_t> clients_data;
+    struct tick_scheduler_t tick;
+    char logs[LOG_LINES_COUNT][LOG_LINE_WIDTH+1];
+
+    struct map_t map;
+};
+
 // Prototypy funkcji
 void *server_display_thread(void *ptr);
 void *server_input_thread(void *ptr);
 void server_init_ncurses(void);
 void server_init_sm(void);
-void server_display_stats(void);
-void server_display_logs(void);
+void server_display_stats(struct server_snapshot_t *snapshot);
+void server_display_logs(struct server_snapshot_t *snapshot);
+void server_publish_snapshot(void);
 void *server_update_thread(void *ptr);
+void server_add_client(int slot, int pid, enum client_type_t type);
+void server_remove_client(int slot);
+void server_poll_dead_clients(void);
+void server_wait_for_clients(uint32_t tick);
+void server_init_stats(void);
+void server_publish_stats(const long long *phase_ns, const uint64_t *counters);
 
 // Pamięć współdzielona
 int fd;
 struct clients_sm_block_t *sm_block;
 
+// Liczba slotów wybrana przy starcie serwera
+int clients_capacity = DEFAULT_CLIENTS_COUNT;
+
+// Rozmiar mapy wybrany przy starcie serwera
+int map_width = DEFAULT_MAP_WIDTH;
+int map_height = DEFAULT_MAP_HEIGHT;
+
+// Ziarno rozgrywki - domyślnie aktualny czas
+unsigned long long match_seed;
+
+// Dziennik wejścia zapisywany w trakcie gry i dziennik odtwarzany zamiast gry
+struct replay_log_t replay_log;
+const char *replay_log_path;
+const char *replay_path;
+
+// Statystyki w osobnej pamięci współdzielonej - zapisują je wątek aktualizujący i wyświetlający, więc zapis jest pod blokadą
+int stats_fd;
+struct stats_block_t *stats_block;
+pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Pula wątków podejmujących decyzje bestii - domyślnie tyle wątków ile procesorów
+struct worker_pool_t beast_pool;
+int beast_threads = 0;
+
+// Sloty istniejące w tablicy i sloty odnotowane w danych serwera - mapy bitowe jak free_slots w pamięci sm
+uint64_t valid_slots[SLOT_BITMAP_WORDS];
+uint64_t registered_slots[SLOT_BITMAP_WORDS];
+
+// Deskryptory pidfd klientów - stają się czytelne w chwili śmierci procesu, -1 gdy slot wolny lub jądro ich nie wspiera
+std::vector<int> client_pidfds;
+std::vector<uint8_t> client_dead;
+
+// Czas ostatniej odpowiedzi klienta - milczenie jest mierzone zegarem, a nie liczbą tur, które przy nadrabianiu następują bez przerw
+std::vector<long long> client_response_ns;
+std::vector<struct pollfd> poll_fds;
+
 // Wyświetlane okna
 WINDOW *stat_window;
 WINDOW *log_window;
@@ -52,9 +127,32 @@ WINDOW *help_window;
 // Wyświetlane logi
 char logs[LOG_LINES_COUNT][LOG_LINE_WIDTH+1];
 
+// Tryb bez terminala - bez ncurses, logi na standardowe wyjście, zamknięcie sygnałem
+int headless;
+
+// Harmonogram tur i jego ustawienia
+struct tick_scheduler_t tick_scheduler;
+long tick_period_ns = TURN_TIME*1000L;
+enum tick_overrun_policy_t tick_policy = TICK_OVERRUN_SKIP;
+
+// Tryb lockstep - maksymalny czas czekania na odpowiedzi klientów, 0 gdy tury odmierza zegar
+long long lockstep_wait_ns = 0;
+std::vector<int> lockstep_pending;
+
 // Działające wątki
 pthread_t input_thread;
 pthread_t update_thread;
+pthread_t display_thread;
+
+// Podwójny bufor migawek - wątek aktualizujący wypełnia tylny i zamienia bufory, wątek wyświetlający wymienia przedni na swój
+struct server_snapshot_t snapshots[2];
+int snapshot_front;
+int snapshot_fresh;
+pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Migawka aktualnie wyświetlana - należy do wątku wyświetlającego, poza punktem widzenia mapy
+struct server_snapshot_t displayed_snapshot;
+int display_dirty;
 
 // Wszystkie dane serwera - oddzielone od mechanizmu komunikacji
 struct server_data_t server_data;
@@ -77,6 +175,7 @@ void *server_input_thread(void *ptr)
         {
             pthread_mutex_lock(&server_data.update_vs_input_mutex);
             SERVER_ADD_LOG("Adding beast");
+            replay_log_add_beast(&replay_log);
             sd_add_beast(&server_data);
             pthread_mutex_unlock(&server_data.update_vs_input_mutex);
         }
@@ -84,6 +183,7 @@ void *server_input_thread(void *ptr)
         {
             pthread_mutex_lock(&server_data.update_vs_input_mutex);
             SERVER_ADD_LOG("Adding coin");
+            replay_log_add_item(&replay_log, TILE_COIN);
             sd_add_something(&server_data, TILE_COIN);
             pthread_mutex_unlock(&server_data.update_vs_input_mutex);
         }
@@ -91,6 +191,7 @@ void *server_input_thread(void *ptr)
         {
             pthread_mutex_lock(&server_data.update_vs_input_mutex);
             SERVER_ADD_LOG("Adding small treasure");
+            replay_log_add_item(&replay_log, TILE_S_TREASURE);
             sd_add_something(&server_data, TILE_S_TREASURE);
             pthread_mutex_unlock(&server_data.update_vs_input_mutex);
         }
@@ -98,113 +199,232 @@ void *server_input_thread(void *ptr)
         {
             pthread_mutex_lock(&server_data.update_vs_input_mutex);
             SERVER_ADD_LOG("Adding big treasure");
+            replay_log_add_item(&replay_log, TILE_L_TREASURE);
             sd_add_something(&server_data, TILE_L_TREASURE);
             pthread_mutex_unlock(&server_data.update_vs_input_mutex);
         }
 
         // Przesówanie mapy
-        else if(c==KEY_UP)
-            map_shift(&server_data.map, 0, -MAP_SHIFT_JUMP_Y);
-        else if(c==KEY_DOWN)
-            map_shift(&server_data.map, 0, MAP_SHIFT_JUMP_Y);
-        else if(c==KEY_LEFT)
-            map_shift(&server_data.map, -MAP_SHIFT_JUMP_X, 0);
-        else if(c==KEY_RIGHT)
-            map_shift(&server_data.map, MAP_SHIFT_JUMP_X, 0);
+        else if(c==KEY_UP || c==KEY_DOWN || c==KEY_LEFT || c==KEY_RIGHT)
+        {
+            pthread_mutex_lock(&snapshot_mutex);
+            if(c==KEY_UP)
+                map_shift(&displayed_snapshot.map, 0, -MAP_SHIFT_JUMP_Y);
+            else if(c==KEY_DOWN)
+                map_shift(&displayed_snapshot.map, 0, MAP_SHIFT_JUMP_Y);
+            else if(c==KEY_LEFT)
+                map_shift(&displayed_snapshot.map, -MAP_SHIFT_JUMP_X, 0);
+            else if(c==KEY_RIGHT)
+                map_shift(&displayed_snapshot.map, MAP_SHIFT_JUMP_X, 0);
+            display_dirty = 1;
+            pthread_mutex_unlock(&snapshot_mutex);
+        }
     }
 }
 
-// wątek komunikujący się z klientami i aktualizujący dane na serwerze
-void *server_update_thread(void *ptr)
+// Wątek wyświetlający - rysuje ostatnią opublikowaną migawkę we własnym tempie, nie spowalniając tury
+void *server_display_thread(void *ptr)
 {
-    pthread_mutex_lock(&server_data.update_vs_input_mutex);
-
     while(1)
     {
-        // W tej pętli odbywa się odczytywanie chęci ruchów wszystkich klientów
-        for(int i=0; i<MAX_CLIENTS_COUNT; i++)
+        // Odebranie najnowszej migawki - punkt widzenia mapy zostaje wybrany przez użytkownika
+        pthread_mutex_lock(&snapshot_mutex);
+        if(snapshot_fresh)
         {
-            // Blok pamięci sm z danymi danego klienta
-            struct client_sm_block_t *client_block = sm_block->clients+i;
+            int viewpoint_x = displayed_snapshot.map.viewpoint_x;
+            int viewpoint_y = displayed_snapshot.map.viewpoint_y;
+            std::swap(displayed_snapshot, snapshots[snapshot_front]);
+            displayed_snapshot.map.viewpoint_x = viewpoint_x;
+            displayed_snapshot.map.viewpoint_y = viewpoint_y;
+            snapshot_fresh = 0;
+            display_dirty = 1;
+        }
+        int redraw = display_dirty;
+        display_dirty = 0;
+        pthread_mutex_unlock(&snapshot_mutex);
 
-            enter_cs(&client_block->data_cs);
+        // Wyświetlenie okien
+        if(redraw)
+        {
+            long long render_start = stats_now_ns();
+            server_display_stats(&displayed_snapshot);
+            server_display_logs(&displayed_snapshot);
+            display_help_window(help_window);
+            map_display(&displayed_snapshot.map, map_window);
+
+            // Serwer zna numery wszystkich graczy
+            for(int i=0; i<(int)displayed_snapshot.clients_data.size(); i++)
+            {
+                struct server_client_data_t *client_data = &displayed_snapshot.clients_data[i];
+                if(client_data->type!=CLIENT_TYPE_FREE)
+                    map_display_player(&displayed_snapshot.map, map_window, client_data->current_x, client_data->current_y, i);
+            }
+            wrefresh(map_window);
 
-            // Wartości w bloku sm
-            enum client_type_t type_block = client_block->data_block.client_type;
-            int pid_block = client_block->data_block.client_pid;
+            long long phase_ns[STATS_PHASES_COUNT];
+            for(int i=0; i<STATS_PHASES_COUNT; i++)
+                phase_ns[i] = -1;
+            phase_ns[STATS_PHASE_RENDER] = stats_now_ns()-render_start;
+            server_publish_stats(phase_ns, NULL);
+        }
 
-            // Wartości w danych serwera
-            enum client_type_t type_server = server_data.clients_data[i].type;
-            int pid_server = server_data.clients_data[i].pid;
+        usleep(DISPLAY_FRAME_TIME);
+    }
+    return NULL;
+}
 
-            // Slot w bloku sm jest wolny
-            if(type_block == CLIENT_TYPE_FREE)
-            {   
-                // Klient wyszedł z gry
-                if(type_server != CLIENT_TYPE_FREE)
-                {
-                    SERVER_ADD_LOG("Client pid=%d exited", server_data.clients_data[i].pid);
-                    sd_remove_client(&server_data, i);
-                }
-            }
+// wątek komunikujący się z klientami i aktualizujący dane na serwerze
+void *server_update_thread(void *ptr)
+{
+    tick_init(&tick_scheduler, tick_period_ns, tick_policy);
 
-            // Slot na serwerze jest zajety
-            else
+    while(1)
+    {
+        // Czasy etapów tej tury, -1 dla etapów, które się nie odbyły, oraz zdarzenia tej tury
+        long long phase_ns[STATS_PHASES_COUNT];
+        uint64_t counters[STATS_COUNTERS_COUNT] = {};
+        for(int i=0; i<STATS_PHASES_COUNT; i++)
+            phase_ns[i] = -1;
+
+        pthread_mutex_lock(&server_data.update_vs_input_mutex);
+        long long tick_start = stats_now_ns();
+        server_data.tick++;
+        replay_log_tick_begin(&replay_log);
+
+        // Klienci, których procesy zakończyły się od poprzedniej tury
+        server_poll_dead_clients();
+
+        // W tej pętli odbywa się odczytywanie chęci ruchów klientów - tylko slotów zajętych w pamięci sm lub w danych serwera
+        for(int w=0; w<SLOT_BITMAP_WORDS; w++)
+        {
+            uint64_t watched = (~__atomic_load_n(sm_block->free_slots+w, __ATOMIC_ACQUIRE) & valid_slots[w]) | registered_slots[w];
+            while(watched!=0)
             {
-                // Sprawdzenie flagi obecności - gdyby klient nie został zamknięty naturalnie
-                if(!client_block->input_block.respond_flag)
-                {
-                    SERVER_ADD_LOG("Client pid=%d doesn't respond", server_data.clients_data[i].pid);
-                    sd_remove_client(&server_data, i);
-                    sm_block->clients[i].data_block.client_type = CLIENT_TYPE_FREE;
-                    
-                    // Naprawa semaforu, który po nienaturalnym zamknięciu klienta jest sygnalizujący
-                    sem_wait(&client_block->output_block_sem);
-                }
-
-                // Klient wyszedł z gry(ale inny zdążył zająć jego miejsce)
-                if(type_server != CLIENT_TYPE_FREE && pid_block != pid_server)
-                {
-                    SERVER_ADD_LOG("Client pid=%d exited", server_data.clients_data[i].pid);
-                    sd_remove_client(&server_data, i);
+                int i = w*64+__builtin_ctzll(watched);
+                watched &= watched-1;
+
+                // Blok pamięci sm z danymi danego klienta
+                struct client_sm_block_t *client_block = sm_block->clients+i;
+
+                // Wartości w bloku sm - klient zapisuje pid przed typem, więc odczyt w odwrotnej kolejności nie wymaga blokady
+                enum client_type_t type_block = __atomic_load_n(&client_block->data_block.client_type, __ATOMIC_ACQUIRE);
+                int pid_block = __atomic_load_n(&client_block->data_block.client_pid, __ATOMIC_ACQUIRE);
+
+                // Wartości w danych serwera
+                enum client_type_t type_server = server_data.clients_data[i].type;
+                int pid_server = server_data.clients_data[i].pid;
+
+                // Slot w bloku sm jest wolny
+                if(type_block == CLIENT_TYPE_FREE)
+                {   
+                    // Klient wyszedł z gry
+                    if(type_server != CLIENT_TYPE_FREE)
+                    {
+                        SERVER_ADD_LOG("Client pid=%d exited", server_data.clients_data[i].pid);
+                        server_remove_client(i);
+                    }
                 }
 
-                // Klient dołączył do gry
-                if(type_server == CLIENT_TYPE_FREE)
+                // Slot na serwerze jest zajety
+                else
                 {
-                    SERVER_ADD_LOG("Client pid=%d joined", pid_block);
-                    sd_add_client(&server_data, i, pid_block, type_block);
+                    // Śmierć procesu zgłoszona przez pidfd - dotyczy tylko klienta odnotowanego w danych serwera
+                    int died = client_dead[i] && pid_block == pid_server;
+
+                    // Sprawdzenie i zresetowanie flagi obecności - gdyby klient nie został zamknięty naturalnie, a jego śmierć nie została zgłoszona
+                    // Klient jest usuwany dopiero po DATA_WAITING_TIME_MAX bez odpowiedzi, niezależnie od długości tury
+                    int responded = __atomic_exchange_n(&client_block->input_block.respond_flag, 0, __ATOMIC_ACQ_REL);
+                    if(responded)
+                        client_response_ns[i] = tick_start;
+                    int silent = !responded && tick_start-client_response_ns[i]>DATA_WAITING_TIME_MAX*1000LL;
+
+                    if(died || silent)
+                    {
+                        if(died)
+                        {
+                            SERVER_ADD_LOG("Client pid=%d died", server_data.clients_data[i].pid);
+                        }
+                        else
+                        {
+                            SERVER_ADD_LOG("Client pid=%d doesn't respond", server_data.clients_data[i].pid);
+                        }
+                        server_remove_client(i);
+                        counters[STATS_COUNTER_EVICTIONS]++;
+
+                        // Zwolnienie slotu - jedyny zapis serwera do danych klienta, więc jedyne miejsce wymagające sekcji krytycznej
+                        if(enter_cs(&client_block->data_cs))
+                            counters[STATS_COUNTER_LOCK_REPAIRS]++;
+                        if(client_block->data_block.client_pid==pid_block && client_block->data_block.client_type!=CLIENT_TYPE_FREE)
+                        {
+                            __atomic_store_n(&client_block->data_block.client_type, CLIENT_TYPE_FREE, __ATOMIC_RELEASE);
+                            slot_table_release(sm_block, i);
+                        }
+                        exit_cs(&client_block->data_cs);
+
+                        // Klient mógł zginąć w trakcie wymiany buforów - serwer jako jedyny korzystający z nich przywraca spójne indeksy
+                        output_buffer_repair_reader(&client_block->output_buffer);
+                    
+                        // Naprawa semaforu, który po nienaturalnym zamknięciu klienta może być sygnalizujący
+                        while(sem_trywait(&client_block->output_block_sem)==0);
+                        continue;
+                    }
+
+                    // Klient wyszedł z gry(ale inny zdążył zająć jego miejsce)
+                    if(type_server != CLIENT_TYPE_FREE && pid_block != pid_server)
+                    {
+                        SERVER_ADD_LOG("Client pid=%d exited", server_data.clients_data[i].pid);
+                        server_remove_client(i);
+
+                        // Slot jest już wolny w danych serwera - nowy klient zostaje odnotowany poniżej, zanim wykona ruch
+                        type_server = CLIENT_TYPE_FREE;
+                    }
+
+                    // Klient dołączył do gry
+                    if(type_server == CLIENT_TYPE_FREE)
+                    {
+                        SERVER_ADD_LOG("Client pid=%d joined", pid_block);
+                        server_add_client(i, pid_block, type_block);
+                    }
+
+                    // Odczytanie co chce zrobić klient w tej turze - bez blokad, najwyżej INPUT_ACTIONS_PER_TICK akcji z kolejki
+                    struct input_entry_t entry;
+                    int actions_count = 0;
+                    while(actions_count<INPUT_ACTIONS_PER_TICK && input_ring_pop(&client_block->input_block, &entry))
+                    {
+                        replay_log_move(&replay_log, i, entry.action);
+                        sd_move(&server_data, i, entry.action);
+                        server_data.clients_data[i].input_seq = entry.seq;
+                        actions_count++;
+                    }
+
+                    // Brak akcji w tej turze - gracz stoi, ale czas w krzakach mija
+                    if(actions_count==0)
+                    {
+                        replay_log_move(&replay_log, i, ACTION_DO_NOTHING);
+                        sd_move(&server_data, i, ACTION_DO_NOTHING);
+                    }
                 }
-
-                // Odczytanie co chce zrobić klient w tej turze
-                enum action_t action = client_block->input_block.action;
-                sd_move(&server_data, i, action);
-                client_block->input_block.action = ACTION_DO_NOTHING;
-
-                // Resetowanie flagi odpowiedzi
-                client_block->input_block.respond_flag = 0;
             }
-
-            exit_cs(&client_block->data_cs);
         }
 
-        struct map_t complete_map;
-        sd_create_complete_map(&server_data, &complete_map);
-
         // Aktualizacja bestii
+        long long phase_start = stats_now_ns();
+        phase_ns[STATS_PHASE_INPUT] = phase_start-tick_start;
         sd_update_beasts(&server_data);
+        phase_ns[STATS_PHASE_BEASTS] = stats_now_ns()-phase_start;
+        phase_start += phase_ns[STATS_PHASE_BEASTS];
 
-        // W tej pętli odbywa się wysyłanie feedbacku do wszystkich klientów
-        for(int i=0; i<MAX_CLIENTS_COUNT; i++)
+        // W tej pętli odbywa się wysyłanie feedbacku do wszystkich odnotowanych klientów
+        for(int k=0; k<(int)server_data.active_slots.size(); k++)
         {
+            int i = server_data.active_slots[k];
+
             // Blok pamięci sm z danymi danego klienta
             struct client_sm_block_t *client_block = sm_block->clients+i;
 
-            enter_cs(&client_block->data_cs);
-
-            // Wartości w bloku sm
-            enum client_type_t type_block = client_block->data_block.client_type;
-            int pid_block = client_block->data_block.client_pid;
+            // Wartości w bloku sm - odczyt bez blokady, dane wysyłane są przez potrójny bufor
+            enum client_type_t type_block = __atomic_load_n(&client_block->data_block.client_type, __ATOMIC_ACQUIRE);
+            int pid_block = __atomic_load_n(&client_block->data_block.client_pid, __ATOMIC_ACQUIRE);
 
             // Wartości w danych serwera
             enum client_type_t type_server = server_data.clients_data[i].type;
@@ -214,30 +434,146 @@ void *server_update_thread(void *ptr)
             if(type_block != CLIENT_TYPE_FREE && type_server != CLIENT_TYPE_FREE && pid_block == pid_server)
             {
                 // Wysłanie feedbacku
-                sd_fill_output_block(&server_data, i, &complete_map, &client_block->output_block);
+                sd_fill_output_block(&server_data, i, &server_data.complete_map, output_buffer_back(&client_block->output_buffer));
+                output_buffer_publish(&client_block->output_buffer);
                 sem_post(&client_block->output_block_sem);
             }
-
-            exit_cs(&client_block->data_cs);
         }
 
-        // Nowa runda
+        phase_ns[STATS_PHASE_OUTPUT] = stats_now_ns()-phase_start;
+
+        // Nowa runda - czas generowania nowej rundy w tle jest znany dopiero po jej przejęciu
         if(sd_is_everything_colected(&server_data))
         {
             SERVER_ADD_LOG("Next round");
+            phase_start = stats_now_ns();
             sd_next_round(&server_data);
+            phase_ns[STATS_PHASE_ROUND_SWITCH] = stats_now_ns()-phase_start;
+            phase_ns[STATS_PHASE_ROUND_GENERATION] = server_data.generation_ns;
+            counters[STATS_COUNTER_ROUND_SWITCHES]++;
         }
 
-        // Wyświetlenie okien
-        server_display_stats();
-        server_display_logs();
-        display_help_window(help_window);
-        map_display(&complete_map, map_window);
+        replay_log_tick_end(&replay_log, &server_data);
+
+        // Przekazanie stanu do wyświetlenia - samo rysowanie odbywa się w osobnym wątku
+        if(!headless)
+        {
+            phase_start = stats_now_ns();
+            server_publish_snapshot();
+            phase_ns[STATS_PHASE_SNAPSHOT] = stats_now_ns()-phase_start;
+        }
+
+        phase_ns[STATS_PHASE_TICK] = stats_now_ns()-tick_start;
+        server_publish_stats(phase_ns, counters);
 
         pthread_mutex_unlock(&server_data.update_vs_input_mutex);
 
-        // Czas trwania jednej tury
-        usleep(TURN_TIME);
+        // Tryb lockstep - kolejna tura zaczyna się gdy tylko wszyscy klienci odpowiedzą
+        if(lockstep_wait_ns>0)
+            server_wait_for_clients(server_data.tick);
+
+        // Czekanie do początku kolejnej tury - termin liczony od siatki, nie od końca pracy
+        else
+            tick_wait(&tick_scheduler);
+    }
+}
+
+// Czekanie aż wszyscy odnotowani klienci wyślą akcję na daną turę, jednak nie dłużej niż lockstep_wait_ns
+// Termin liczony zegarem monotonicznym, jak w harmonogramie tur - przestawienie zegara systemowego nie skraca ani nie wydłuża tury
+// Lista klientów jest zmieniana tylko przez wątek aktualizujący, więc odczyt bez blokady jest bezpieczny
+void server_wait_for_clients(uint32_t tick)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    long long temp_ns = deadline.tv_nsec + lockstep_wait_ns;
+    deadline.tv_sec += temp_ns / 1000000000;
+    deadline.tv_nsec = temp_ns % 1000000000;
+
+    // Bez klientów nie ma na kogo czekać - tura trwa wtedy najdłużej jak może, by serwer nie kręcił się w pustej pętli
+    lockstep_pending = server_data.active_slots;
+    if(lockstep_pending.empty())
+    {
+        while(sem_clockwait(&sm_block->lockstep_sem, CLOCK_MONOTONIC, &deadline)==0 || errno!=ETIMEDOUT);
+        return;
+    }
+
+    while(1)
+    {
+        // Usunięcie z listy klientów, którzy już odpowiedzieli
+        for(int k=0; k<(int)lockstep_pending.size(); )
+        {
+            struct client_sm_block_t *client_block = sm_block->clients+lockstep_pending[k];
+            uint32_t acked_tick = __atomic_load_n(&client_block->input_block.acked_tick, __ATOMIC_ACQUIRE);
+            if((int32_t)(acked_tick-tick)>=0)
+            {
+                lockstep_pending[k] = lockstep_pending.back();
+                lockstep_pending.pop_back();
+            }
+            else
+                k++;
+        }
+
+        if(lockstep_pending.empty())
+            break;
+
+        // Każda odpowiedź klienta sygnalizuje semafor
+        if(sem_clockwait(&sm_block->lockstep_sem, CLOCK_MONOTONIC, &deadline)!=0 && errno==ETIMEDOUT)
+            break;
+    }
+
+    // Spóźnione sygnały z tej tury nie powinny budzić serwera w kolejnej
+    while(sem_trywait(&sm_block->lockstep_sem)==0);
+}
+
+// Odnotowanie klienta w danych serwera i rozpoczęcie obserwowania jego procesu
+void server_add_client(int slot, int pid, enum client_type_t type)
+{
+    replay_log_join(&replay_log, slot, pid, type);
+    sd_add_client(&server_data, slot, pid, type);
+    registered_slots[slot/64] |= 1ULL<<(slot%64);
+
+    // Przy braku wsparcia jądra dla pidfd pozostaje wykrywanie przez flagę obecności
+    client_pidfds[slot] = syscall(SYS_pidfd_open, pid, 0);
+}
+
+// Usunięcie klienta z danych serwera i zakończenie obserwowania jego procesu
+void server_remove_client(int slot)
+{
+    replay_log_leave(&replay_log, slot);
+    sd_remove_client(&server_data, slot);
+    registered_slots[slot/64] &= ~(1ULL<<(slot%64));
+    client_dead[slot] = 0;
+
+    if(client_pidfds[slot]!=-1)
+    {
+        close(client_pidfds[slot]);
+        client_pidfds[slot] = -1;
+    }
+}
+
+// Sprawdzenie bez czekania, których obserwowanych klientów procesy już się zakończyły - wynik w client_dead
+void server_poll_dead_clients(void)
+{
+    poll_fds.clear();
+    for(int k=0; k<(int)server_data.active_slots.size(); k++)
+    {
+        int slot = server_data.active_slots[k];
+        struct pollfd entry;
+        entry.fd = client_pidfds[slot];
+        entry.events = POLLIN;
+        entry.revents = 0;
+        poll_fds.push_back(entry);
+    }
+
+    // Ujemne deskryptory są pomijane przez poll
+    int res = poll(poll_fds.data(), poll_fds.size(), 0);
+    if(res<=0)
+        return;
+
+    for(int k=0; k<(int)poll_fds.size(); k++)
+    {
+        if(poll_fds[k].revents & (POLLIN | POLLHUP | POLLERR))
+            client_dead[server_data.active_slots[k]] = 1;
     }
 }
 
@@ -252,6 +588,7 @@ void server_init_ncurses(void)
     cbreak();
 
     init_colors();
+    check_set_handler(display_check_failed);
 
     stat_window = newwin(36, 30, 0, 0);
     log_window = newwin(LOG_LINES_COUNT+1, LOG_LINE_WIDTH, 38, 0);
@@ -272,41 +609,159 @@ void server_init_sm(void)
     fd = shm_open(SHM_FILE_NAME, O_CREAT | O_RDWR, 0600);
     check(fd!=-1, "shm_open error");
 
-    int res = ftruncate(fd, SHARED_BLOCK_SIZE);
+    int res = ftruncate(fd, SHARED_BLOCK_SIZE(clients_capacity));
     check(res!=-1, "ftruncate error");
 
-    sm_block = (struct clients_sm_block_t *)mmap(NULL, SHARED_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    sm_block = (struct clients_sm_block_t *)mmap(NULL, SHARED_BLOCK_SIZE(clients_capacity), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     check(sm_block!=MAP_FAILED, "mmap error");
 
-    for(int i=0; i<MAX_CLIENTS_COUNT; i++)
+    client_pidfds.assign(clients_capacity, -1);
+    client_dead.assign(clients_capacity, 0);
+    client_response_ns.assign(clients_capacity, stats_now_ns());
+
+    for(int i=0; i<clients_capacity; i++)
     {
         struct client_sm_block_t *client_block = sm_block->clients+i;
 
         client_block->data_block.client_pid = 0;
         client_block->data_block.client_type = CLIENT_TYPE_FREE;
-        client_block->input_block.action = ACTION_DO_NOTHING;
+        client_block->input_block.head = 0;
+        client_block->input_block.tail = 0;
+        output_buffer_init(&client_block->output_buffer);
 
-        sem_init(&client_block->data_cs, 1, 1);
+        init_cs(&client_block->data_cs);
         sem_init(&client_block->output_block_sem, 1, 0);
     }
+
+    sm_block->lockstep = lockstep_wait_ns>0;
+    sem_init(&sm_block->lockstep_sem, 1, 0);
+    sm_block->map_width = map_width;
+    sm_block->map_height = map_height;
+    // W trybie lockstep tura trwa najwyżej lockstep_wait_ns - tyle czeka się na klienta, który nie wysłał akcji
+    sm_block->turn_time_ns = lockstep_wait_ns>0 ? lockstep_wait_ns : tick_period_ns;
+
+    // Otwarcie slotów dla klientów dopiero po przygotowaniu wszystkich bloków
+    slot_table_init(sm_block, clients_capacity);
+    memcpy(valid_slots, sm_block->free_slots, sizeof(valid_slots));
+}
+
+// Wypełnienie tylnego bufora migawki aktualnym stanem serwera i zamiana buforów
+void server_publish_snapshot(void)
+{
+    struct server_snapshot_t *back = snapshots+(1-snapshot_front);
+
+    back->server_pid = server_data.server_pid;
+    back->round = server_data.round;
+    back->clients_data = server_data.clients_data;
+    memcpy(back->logs, logs, sizeof(back->logs));
+    back->tick = tick_scheduler;
+
+    // Kopiowany jest jedynie fragment mapy wokół wyświetlanego okna - z zapasem na przewijanie przed kolejną turą
+    pthread_mutex_lock(&snapshot_mutex);
+    int viewpoint_x = displayed_snapshot.map.viewpoint_x;
+    int viewpoint_y = displayed_snapshot.map.viewpoint_y;
+    pthread_mutex_unlock(&snapshot_mutex);
+
+    back->map.campside_x = server_data.complete_map.campside_x;
+    back->map.campside_y = server_data.complete_map.campside_y;
+    map_copy_area(&server_data.complete_map, &back->map, viewpoint_x-MAP_VIEW_WIDTH, viewpoint_y-MAP_VIEW_HEIGHT, MAP_VIEW_WIDTH*3, MAP_VIEW_HEIGHT*3);
+
+    pthread_mutex_lock(&snapshot_mutex);
+    snapshot_front = 1-snapshot_front;
+    snapshot_fresh = 1;
+    pthread_mutex_unlock(&snapshot_mutex);
+}
+
+// Przygotowanie pamięci współdzielonej ze statystykami - czytelnicy mogą ją tylko czytać
+void server_init_stats(void)
+{
+    stats_fd = shm_open(STATS_SHM_FILE_NAME, O_CREAT | O_RDWR, 0644);
+    check(stats_fd!=-1, "shm_open error");
+
+    int res = ftruncate(stats_fd, sizeof(struct stats_block_t));
+    check(res!=-1, "ftruncate error");
+
+    stats_block = (struct stats_block_t *)mmap(NULL, sizeof(struct stats_block_t), PROT_READ | PROT_WRITE, MAP_SHARED, stats_fd, 0);
+    check(stats_block!=MAP_FAILED, "mmap error");
+
+    memset(stats_block, 0, sizeof(struct stats_block_t));
+    stats_block->version = STATS_VERSION;
+    stats_block->server_pid = server_data.server_pid;
+}
+
+// Dopisanie czasów etapów i zdarzeń do statystyk oraz odświeżenie stanu gry - ujemny czas oznacza etap, który się nie odbył
+void server_publish_stats(const long long *phase_ns, const uint64_t *counters)
+{
+    pthread_mutex_lock(&stats_mutex);
+    stats_write_begin(stats_block);
+
+    for(int i=0; i<STATS_PHASES_COUNT; i++)
+    {
+        if(phase_ns[i]>=0)
+            stats_histogram_record(stats_block->phases+i, phase_ns[i]);
+    }
+
+    // Stan gry odczytywany tylko przez wątek aktualizujący, pod blokadą danych serwera
+    if(counters!=NULL)
+    {
+        for(int i=0; i<STATS_COUNTERS_COUNT; i++)
+            stats_block->counters[i] += counters[i];
+        stats_block->tick = server_data.tick;
+        stats_block->round = server_data.round;
+        stats_block->players = server_data.active_slots.size();
+        stats_block->beasts = server_data.beasts.size();
+        stats_block->overruns = tick_scheduler.overruns;
+    }
+
+    stats_write_end(stats_block);
+    pthread_mutex_unlock(&stats_mutex);
 }
 
 // Wyświetlenie statystyk serwera
-void server_display_stats(void)
+void server_display_stats(struct server_snapshot_t *snapshot)
 {
     werase(stat_window);
 
     wattron(stat_window, COLOR_PAIR(COLOR_WHITE_ON_RED));
-    mvwprintw(stat_window, 0, 0, "Servers PID  : %d", server_data.server_pid);
+    mvwprintw(stat_window, 0, 0, "Servers PID  : %d", snapshot->server_pid);
     wattron(stat_window, COLOR_PAIR(COLOR_BLACK_ON_WHITE));
-    mvwprintw(stat_window, 1, 0, "Campside X/Y : %d/%d", server_data.map.campside_x, server_data.map.campside_y);
-    mvwprintw(stat_window, 2, 0, "Round Number : %d", server_data.round);
+    mvwprintw(stat_window, 1, 0, "Campside X/Y : %d/%d", snapshot->map.campside_x, snapshot->map.campside_y);
+    mvwprintw(stat_window, 2, 0, "Round Number : %d", snapshot->round);
+    mvwprintw(stat_window, 3, 0, "Tick Jitter  : %ld/%ld/%ld us", snapshot->tick.last_jitter_ns/1000, tick_average_jitter_ns(&snapshot->tick)/1000,
+        snapshot->tick.max_jitter_ns/1000);
+    mvwprintw(stat_window, 4, 0, "Overruns     : %lld (%lld skipped)", snapshot->tick.overruns, snapshot->tick.skipped);
 
     int line = 5;
+    int capacity = snapshot->clients_data.size();
+
+    // Przy dużej liczbie slotów pełne opisy się nie mieszczą - jeden wiersz na zajęty slot, dopóki starczy okna
+    if(capacity>DEFAULT_CLIENTS_COUNT)
+    {
+        int players_count = 0;
+        for(int i=0; i<capacity; i++)
+            players_count += snapshot->clients_data[i].type!=CLIENT_TYPE_FREE;
+
+        mvwprintw(stat_window, line++, 0, "Players      : %d/%d", players_count, capacity);
+        line++;
+        wattron(stat_window, COLOR_PAIR(COLOR_WHITE_ON_RED));
+        mvwprintw(stat_window, line++, 0, "Nr   Pos     Deaths Coins");
+        wattron(stat_window, COLOR_PAIR(COLOR_BLACK_ON_WHITE));
+
+        for(int i=0; i<capacity && line<getmaxy(stat_window); i++)
+        {
+            struct server_client_data_t *client_data = &snapshot->clients_data[i];
+            if(client_data->type==CLIENT_TYPE_FREE)
+                continue;
+            mvwprintw(stat_window, line++, 0, "%-4d %3d/%-3d %-6d %d/%d", i+1, client_data->current_x, client_data->current_y,
+                client_data->deaths, client_data->coins_found, client_data->coins_brought);
+        }
+        wrefresh(stat_window);
+        return;
+    }
 
-    for(int i=0; i<MAX_CLIENTS_COUNT; i++)
+    for(int i=0; i<capacity; i++)
     {
-        enum client_type_t type = server_data.clients_data[i].type;
+        enum client_type_t type = snapshot->clients_data[i].type;
 
         wattron(stat_window, COLOR_PAIR(COLOR_WHITE_ON_RED));
         mvwprintw(stat_window, line++, 0, "--PLAYER %d--", i+1);
@@ -330,7 +785,7 @@ void server_display_stats(void)
 
         else
         {
-            struct server_client_data_t *client_data = server_data.clients_data+i;
+            struct server_client_data_t *client_data = &snapshot->clients_data[i];
 
             mvwprintw(stat_window, line++, 0, "PID:    %d", client_data->pid);
             mvwprintw(stat_window, line++, 0, "Number: %d", i+1);
@@ -344,7 +799,7 @@ void server_display_stats(void)
 }
 
 // Wyświetlenie logów serwera
-void server_display_logs(void)
+void server_display_logs(struct server_snapshot_t *snapshot)
 {
     werase(log_window);
     int line=0;
@@ -352,37 +807,160 @@ void server_display_logs(void)
     mvwprintw(log_window, line++, 0, "-----------Logs-----------");
     wattron(log_window, COLOR_PAIR(COLOR_BLACK_ON_WHITE));
     for(int i=0; i<LOG_LINES_COUNT; i++)
-        mvwprintw(log_window, line++, 0, logs[i]);
+        mvwprintw(log_window, line++, 0, snapshot->logs[i]);
     wrefresh(log_window);
 }
 
 // Funkcja main
-int main(void)
+int main(int argc, char **argv)
 {
+    // Argumenty
+    match_seed = time(NULL);
+    int opt;
+    int usage_error = 0;
+    while((opt = getopt(argc, argv, "Hr:o:c:j:l:m:s:L:R:")) != -1)
+    {
+        int width = 0;
+        int height = 0;
+        if(opt=='H')
+            headless = 1;
+        else if(opt=='m' && sscanf(optarg, "%dx%d", &width, &height)==2 && width%2==1 && height%2==1
+            && width>=MAP_MIN_SIZE && height>=MAP_MIN_SIZE && width<=MAP_MAX_SIZE && height<=MAP_MAX_SIZE)
+        {
+            map_width = width;
+            map_height = height;
+        }
+        else if(opt=='s' && sscanf(optarg, "%llu", &match_seed)==1)
+            continue;
+        else if(opt=='L')
+            replay_log_path = optarg;
+        else if(opt=='R')
+            replay_path = optarg;
+        else if(opt=='r' && atof(optarg)>0)
+            tick_period_ns = (long)(1e9/atof(optarg));
+        else if(opt=='c' && atoi(optarg)>0 && atoi(optarg)<=MAX_CLIENTS_COUNT)
+            clients_capacity = atoi(optarg);
+        else if(opt=='l' && atof(optarg)>0)
+            lockstep_wait_ns = (long long)(atof(optarg)*1e6);
+        else if(opt=='j' && atoi(optarg)>0)
+            beast_threads = atoi(optarg);
+        else if(opt=='o' && strcmp(optarg, "skip")==0)
+            tick_policy = TICK_OVERRUN_SKIP;
+        else if(opt=='o' && strcmp(optarg, "catchup")==0)
+            tick_policy = TICK_OVERRUN_CATCH_UP;
+        else
+            usage_error = 1;
+    }
+
+    if(usage_error)
+    {
+        fprintf(stderr, "Usage: %s [-H] [-r rate] [-o skip|catchup] [-c clients] [-j threads] [-l max_wait_ms] [-m WIDTHxHEIGHT] [-s seed] [-L log] [-R log]\n"
+            "  -H  headless mode, no terminal UI, stop with SIGINT/SIGTERM\n"
+            "  -r  ticks per second (default %d)\n"
+            "  -o  what to do with ticks that overrun their period (default skip)\n"
+            "  -c  number of client slots, up to %d (default %d)\n"
+            "  -j  threads deciding beast moves (default: number of CPUs)\n"
+            "  -l  lockstep mode, next tick starts when all clients sent their actions, waiting at most max_wait_ms\n"
+            "      (clients read the bound from shared memory and wait for data that long plus %d ms)\n"
+            "  -m  map size, odd numbers from %d to %d (default %dx%d)\n"
+            "  -s  match seed, the same seed and the same inputs give the same match (default: current time)\n"
+            "  -L  record the seed, clients' actions and admin commands to a binary log\n"
+            "  -R  replay a recorded log headless as fast as possible and exit, -j still applies\n", argv[0], 1000000/TURN_TIME, MAX_CLIENTS_COUNT, DEFAULT_CLIENTS_COUNT, DATA_WAITING_TIME_MAX/1000,
+            MAP_MIN_SIZE, MAP_MAX_SIZE, DEFAULT_MAP_WIDTH, DEFAULT_MAP_HEIGHT);
+        return 1;
+    }
+
+    // Odtworzenie zapisanej rozgrywki - bez pamięci współdzielonej, terminala i czekania na kolejne tury
+    if(replay_path!=NULL)
+    {
+        if(beast_threads==0)
+            beast_threads = sysconf(_SC_NPROCESSORS_ONLN);
+        pool_init(&beast_pool, beast_threads);
+
+        struct replay_result_t result;
+        replay_run(replay_path, &beast_pool, &result);
+
+        double seconds = result.elapsed_ns/1e9;
+        printf("Replayed %s: seed=%llu map=%dx%d slots=%d\n", replay_path, (unsigned long long)result.header.seed,
+            result.header.map_width, result.header.map_height, result.header.capacity);
+        printf("Ticks=%lld events=%lld time=%.3f s (%.0f ticks/s, %.1f us/tick)\n", result.ticks, result.events, seconds,
+            seconds>0 ? result.ticks/seconds : 0.0, result.ticks>0 ? result.elapsed_ns/1000.0/result.ticks : 0.0);
+        printf("Final state hash=%016llx\n", (unsigned long long)result.final_hash);
+        if(result.first_mismatch_tick>=0)
+        {
+            printf("State diverged from the log at tick %lld, replay stopped\n", result.first_mismatch_tick);
+            return 1;
+        }
+        printf("State matched the log after every tick\n");
+        return 0;
+    }
+
+    // W trybie bez terminala zamknięcie następuje sygnałem - blokowany we wszystkich wątkach i odbierany przez sigwait
+    sigset_t exit_signals;
+    sigemptyset(&exit_signals);
+    sigaddset(&exit_signals, SIGINT);
+    sigaddset(&exit_signals, SIGTERM);
+    if(headless)
+        pthread_sigmask(SIG_BLOCK, &exit_signals, NULL);
+
     // Inicjacja
-    srand(time(NULL));
-    sd_init(&server_data);
-    server_init_ncurses();
+    sd_init(&server_data, clients_capacity, map_width, map_height, match_seed);
+    if(replay_log_path!=NULL)
+        replay_log_open(&replay_log, replay_log_path, &server_data);
+    for(int i=0; i<2; i++)
+        map_init(&snapshots[i].map, map_width, map_height);
+    map_init(&displayed_snapshot.map, map_width, map_height);
+    if(beast_threads==0)
+        beast_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    pool_init(&beast_pool, beast_threads);
+    server_data.pool = &beast_pool;
+    if(!headless)
+        server_init_ncurses();
     server_init_sm();
+    server_init_stats();
     sd_next_round(&server_data);
 
-    SERVER_ADD_LOG("Starting Server, pid=%d", server_data.server_pid);
+    SERVER_ADD_LOG("Starting Server, pid=%d seed=%llu", server_data.server_pid, match_seed);
 
     // Tworzenie wątków
-    pthread_create(&input_thread, NULL, server_input_thread, NULL);
     pthread_create(&update_thread, NULL, server_update_thread, NULL);
 
-    pthread_join(input_thread, NULL);
+    if(headless)
+    {
+        int sig = 0;
+        sigwait(&exit_signals, &sig);
+        SERVER_ADD_LOG("Stopping Server, signal=%d", sig);
+        SERVER_ADD_LOG("Ticks=%u overruns=%lld", server_data.tick, tick_scheduler.overruns);
+        SERVER_ADD_LOG("Jitter avg/max=%d/%d us", (int)(tick_average_jitter_ns(&tick_scheduler)/1000), (int)(tick_scheduler.max_jitter_ns/1000));
+    }
+    else
+    {
+        pthread_create(&input_thread, NULL, server_input_thread, NULL);
+        pthread_create(&display_thread, NULL, server_display_thread, NULL);
+        pthread_join(input_thread, NULL);
+        pthread_cancel(display_thread);
+    }
+
     pthread_cancel(update_thread);
 
+    // Wątek aktualizujący mógł zostać przerwany w trakcie tury - urwany ostatni rekord jest pomijany przy odtwarzaniu
+    pthread_join(update_thread, NULL);
+    replay_log_close(&replay_log);
+
     // Sprzątanie
-    munmap(sm_block, SHARED_BLOCK_SIZE);
+    munmap(sm_block, SHARED_BLOCK_SIZE(clients_capacity));
     close(fd);
     shm_unlink(SHM_FILE_NAME);
-    endwin();
-    delwin(log_window);
-    delwin(stat_window);
-    delwin(map_window);
-    delwin(help_window);
+    munmap(stats_block, sizeof(struct stats_block_t));
+    close(stats_fd);
+    shm_unlink(STATS_SHM_FILE_NAME);
+    if(!headless)
+    {
+        endwin();
+        delwin(log_window);
+        delwin(stat_window);
+        delwin(map_window);
+        delwin(help_window);
+    }
     return 0;
 }
\ No newline at end of file
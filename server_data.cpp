@@ -1,22 +1,128 @@
 #include <unistd.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <utility>
+#include <algorithm>
 #include "server_data.h"
 #include "common.h"
 #include "map.h"
 #include "beast.h"
+#include "stats.h"
 #include "tiles.h"
 
-// Inicjowanie danych serwera
-void sd_init(struct server_data_t *data)
+// Funkcje statyczne
+static int sd_cell_index(struct server_data_t *sd, int x, int y);
+static void sd_place_item(struct server_data_t *sd, int x, int y, enum tile_t tile);
+static void sd_player_unlink(struct server_data_t *sd, int slot);
+static void sd_player_set_position(struct server_data_t *sd, int slot, int x, int y);
+static int sd_players_in_cell(struct server_data_t *sd, int cell, int skip_slot, std::vector<int> *result);
+static void sd_decide_beasts_task(void *arg, int begin, int end);
+static int sd_beast_surrounding_changed(struct server_data_t *sd, struct beast_t *beast);
+static void *sd_next_round_thread(void *ptr);
+static void sd_prepare_next_round(struct server_data_t *sd);
+
+// Indeks komórki w siatkach indeksu przestrzennego
+static int sd_cell_index(struct server_data_t *sd, int x, int y)
+{
+    return y*sd->map.width+x;
+}
+
+// Umieszczenie monety/skarbu w danej komórce
+static void sd_place_item(struct server_data_t *sd, int x, int y, enum tile_t tile)
+{
+    int cell = sd_cell_index(sd, x, y);
+    if(sd->items[cell]==TILE_VOID)
+        sd->items_count++;
+    sd->items[cell] = tile;
+    sd_redraw_tile(sd, x, y);
+}
+
+// Usunięcie gracza z listy graczy jego komórki
+static void sd_player_unlink(struct server_data_t *sd, int slot)
 {
-    for(int i=0; i<MAX_CLIENTS_COUNT; i++)
+    int cell = sd->players_cell[slot];
+    if(cell==-1)
+        return;
+
+    int prev = sd->players_prev[slot];
+    int next = sd->players_next[slot];
+    if(prev!=-1)
+        sd->players_next[prev] = next;
+    else
+        sd->players_first[cell] = next;
+    if(next!=-1)
+        sd->players_prev[next] = prev;
+
+    sd->players_cell[slot] = -1;
+}
+
+// Zmiana pozycji gracza razem z przeniesieniem go na listę graczy nowej komórki
+static void sd_player_set_position(struct server_data_t *sd, int slot, int x, int y)
+{
+    struct server_client_data_t *client = &sd->clients_data[slot];
+    sd_player_unlink(sd, slot);
+
+    client->current_x = x;
+    client->current_y = y;
+
+    int cell = sd_cell_index(sd, x, y);
+    int first = sd->players_first[cell];
+    sd->players_prev[slot] = -1;
+    sd->players_next[slot] = first;
+    if(first!=-1)
+        sd->players_prev[first] = slot;
+    sd->players_first[cell] = slot;
+    sd->players_cell[slot] = cell;
+}
+
+// Zebranie graczy stojących w komórce (poza skip_slot) - zwraca ich liczbę
+// Lista jest kopiowana, bo zabijanie graczy przenosi ich do innych komórek
+static int sd_players_in_cell(struct server_data_t *sd, int cell, int skip_slot, std::vector<int> *result)
+{
+    result->clear();
+    for(int slot=sd->players_first[cell]; slot!=-1; slot=sd->players_next[slot])
     {
-        struct server_client_data_t *client_data = data->clients_data + i;
-        client_data->type = CLIENT_TYPE_FREE;
+        if(slot!=skip_slot)
+            result->push_back(slot);
     }
+    return result->size();
+}
 
+// Inicjowanie danych serwera
+void sd_init(struct server_data_t *data, int capacity, int map_width, int map_height, uint64_t seed)
+{
+    int cells_count = map_width*map_height;
+    map_init(&data->map, map_width, map_height);
+    map_init(&data->complete_map, map_width, map_height);
+
+    struct server_client_data_t free_client = {};
+    free_client.type = CLIENT_TYPE_FREE;
+    data->clients_data.assign(capacity, free_client);
+    data->active_slots.clear();
+    data->active_positions.assign(capacity, -1);
+    data->players_first.assign(cells_count, -1);
+    data->players_next.assign(capacity, -1);
+    data->players_prev.assign(capacity, -1);
+    data->players_cell.assign(capacity, -1);
+
+    data->seed = seed;
+    rng_seed_stream(&data->maze_rng, seed, RNG_STREAM_MAZE);
+    rng_seed_stream(&data->entities_rng, seed, RNG_STREAM_ENTITIES);
+    rng_seed_stream(&data->beasts_rng, seed, RNG_STREAM_BEASTS);
+    data->next_round = NULL;
+    data->generation_ns = 0;
     data->server_pid = getpid();
     data->round = 0;
+    data->tick = 0;
+    data->players_field_valid = 0;
+    data->players_field_version = 0;
+    data->tile_changes.assign(cells_count, 0);
+    data->tile_change_stamp = 0;
+    data->pool = NULL;
+
+    data->items.assign(cells_count, TILE_VOID);
+    data->items_count = 0;
+    data->beasts_count.assign(cells_count, 0);
 
     pthread_mutex_init(&data->update_vs_input_mutex, NULL);
 }
@@ -24,27 +130,53 @@ void sd_init(struct server_data_t *data)
 // Dodanie klienta do gry na danych slocie
 void sd_add_client(struct server_data_t *data, int slot, int pid, enum client_type_t type)
 {
-    struct server_client_data_t *client_data = data->clients_data + slot;
+    struct server_client_data_t *client_data = &data->clients_data[slot];
     client_data->type = type;
     client_data->pid = pid;
     client_data->turns_to_wait = 0;
     client_data->coins_found = 0;
     client_data->coins_brought = 0;
     client_data->deaths = 0;
+    client_data->input_seq = 0;
+
+    if(data->active_positions[slot]==-1)
+    {
+        data->active_positions[slot] = data->active_slots.size();
+        data->active_slots.push_back(slot);
+    }
+
     sd_set_player_spawn(data, slot);
 }
 
 // Usunięcie klienta z danego slotu z gry
 void sd_remove_client(struct server_data_t *data, int slot)
 {
-    struct server_client_data_t *client_data = data->clients_data + slot;
+    struct server_client_data_t *client_data = &data->clients_data[slot];
     client_data->type = CLIENT_TYPE_FREE;
+    sd_player_unlink(data, slot);
+
+    // Usunięcie z listy zajętych slotów - na jego miejsce trafia ostatni
+    int position = data->active_positions[slot];
+    if(position!=-1)
+    {
+        int last = data->active_slots.back();
+        data->active_slots[position] = last;
+        data->active_positions[last] = position;
+        data->active_slots.pop_back();
+        data->active_positions[slot] = -1;
+    }
+
+    sd_redraw_tile(data, client_data->current_x, client_data->current_y);
 }
 
 // Ruch gracza
 void sd_move(struct server_data_t *sd, int slot, enum action_t action)
 {
-    struct server_client_data_t *client_data = sd->clients_data+slot;
+    struct server_client_data_t *client_data = &sd->clients_data[slot];
+
+    // Wolny slot nie ma gracza na mapie - ruch nie może go z powrotem dołączyć do listy graczy w kratce
+    if(client_data->type==CLIENT_TYPE_FREE)
+        return;
 
     // Gracz stoi w krzakach
     if(client_data->turns_to_wait>0)
@@ -66,8 +198,8 @@ void sd_move(struct server_data_t *sd, int slot, enum action_t action)
     else if(action==ACTION_GO_LEFT) next_x--;
     else if(action==ACTION_GO_RIGHT) next_x++;
 
-    // Kafelek docelowy
-    enum tile_t dest_tile = map_get_tile(&sd->map, next_x, next_y);
+    // Kafelek docelowy - krok od mapy wypada najdalej w ramce
+    enum tile_t dest_tile = map_tile_at(&sd->map, next_x, next_y);
 
     // Zderzenie ze ścianą - ruch odrzucony
     if(dest_tile==TILE_WALL)
@@ -81,42 +213,20 @@ void sd_move(struct server_data_t *sd, int slot, enum action_t action)
         client_data->turns_to_wait = 1;
     }
 
-    // Zbieranie monet
-    for(int i=0; i<(int)sd->coins_data.size(); i++)
+    // Zbieranie monet i skarbów
+    int next_cell = sd_cell_index(sd, next_x, next_y);
+    enum tile_t item = sd->items[next_cell];
+    if(item!=TILE_VOID)
     {
-        struct server_something_data_t *sth = &(sd->coins_data.at(i));
-        if(sth->x==next_x && sth->y==next_y)
-        {
-            client_data->coins_found += 1;
-            sd->coins_data.erase(sd->coins_data.begin()+i);
-        }
-    }
-
-    // Zbieranie małych skarbów
-    for(int i=0; i<(int)sd->treasures_s_data.size(); i++)
-    {
-        struct server_something_data_t *sth = &(sd->treasures_s_data.at(i));
-        if(sth->x==next_x && sth->y==next_y)
-        {
-            client_data->coins_found += SMALL_TREASURE_VALUE;
-            sd->treasures_s_data.erase(sd->treasures_s_data.begin()+i);
-        }
-    }
-
-    // Zbieranie dużych skarbów
-    for(int i=0; i<(int)sd->treasures_l_data.size(); i++)
-    {
-        struct server_something_data_t *sth = &(sd->treasures_l_data.at(i));
-        if(sth->x==next_x && sth->y==next_y)
-        {
-            client_data->coins_found += BIG_TREASURE_VALUE;
-            sd->treasures_l_data.erase(sd->treasures_l_data.begin()+i);
-        }
+        if(item==TILE_COIN) client_data->coins_found += 1;
+        else if(item==TILE_S_TREASURE) client_data->coins_found += SMALL_TREASURE_VALUE;
+        else if(item==TILE_L_TREASURE) client_data->coins_found += BIG_TREASURE_VALUE;
+        sd->items[next_cell] = TILE_VOID;
+        sd->items_count--;
     }
 
     // Aktualizacja pozycji
-    client_data->current_x = next_x;
-    client_data->current_y = next_y;
+    sd_player_set_position(sd, slot, next_x, next_y);
 
     // Wejście do obozu - W obozie nie obowiązują zderzenia z innymi graczami
     if(client_data->current_x == sd->map.campside_x && client_data->current_y==sd->map.campside_y)
@@ -126,43 +236,32 @@ void sd_move(struct server_data_t *sd, int slot, enum action_t action)
     }
     else
     {
-        // Zderzenia z innymi graczami
-        int kill_player = 0;
-        for(int i=0; i<MAX_CLIENTS_COUNT; i++)
+        // Zderzenia z innymi graczami - tylko gracze stojący w tej samej komórce
+        std::vector<int> &victims = sd->collision_victims;
+        if(sd_players_in_cell(sd, sd_cell_index(sd, next_x, next_y), slot, &victims)>0)
         {
-            struct server_client_data_t *client_data2 = sd->clients_data+i;
-            if(client_data2->type!=CLIENT_TYPE_FREE)
-            {
-                if(i!=slot && client_data2->current_x==client_data->current_x && client_data2->current_y==client_data->current_y)
-                {
-                    kill_player = 1;
-                    sd_player_kill(sd, i);
-                }
-            }
-        }
-        if(kill_player)
+            for(int k=0; k<(int)victims.size(); k++)
+                sd_player_kill(sd, victims[k]);
             sd_player_kill(sd, slot);
+        }
     }
 
     // Zderzenia z bestiami
-    for(int i=0; i<(int)sd->beasts.size(); i++)
-    {
-        struct beast_t *beast = &(sd->beasts.at(i));
-        if(client_data->current_x==beast->x && client_data->current_y==beast->y)
-            sd_player_kill(sd, slot);
-    }
+    if(sd->beasts_count[sd_cell_index(sd, client_data->current_x, client_data->current_y)]>0)
+        sd_player_kill(sd, slot);
     
     // Zbieranie dropów
-    for(int i=0; i<(int)sd->dropped_data.size(); i++)
+    std::unordered_map<int, int>::iterator drop = sd->dropped_data.find(sd_cell_index(sd, client_data->current_x, client_data->current_y));
+    if(drop!=sd->dropped_data.end())
     {
-        struct server_drop_data_t *drop = &(sd->dropped_data.at(i));
-        if(client_data->current_x==drop->x && client_data->current_y==drop->y)
-        {
-            client_data->coins_found += drop->value;
-            sd->dropped_data.erase(sd->dropped_data.begin()+i);
-            i--;
-        }
+        client_data->coins_found += drop->second;
+        sd->dropped_data.erase(drop);
     }
+
+    // Odświeżenie pełnej mapy w miejscach, które mogły się zmienić
+    sd_redraw_tile(sd, current_x, current_y);
+    sd_redraw_tile(sd, next_x, next_y);
+    sd_redraw_tile(sd, client_data->current_x, client_data->current_y);
 }
 
 // Ruch bestii
@@ -188,37 +287,36 @@ void sd_move_beast(struct server_data_t *sd, struct beast_t *beast, enum action_
     else if(action==ACTION_GO_LEFT) next_x--;
     else if(action==ACTION_GO_RIGHT) next_x++;
 
-    // Kafelek docelowy
-    enum tile_t dest_tile = map_get_tile(&sd->map, next_x, next_y);
+    // Kafelek docelowy - krok od mapy wypada najdalej w ramce
+    enum tile_t dest_tile = map_tile_at(&sd->map, next_x, next_y);
 
     // Zderzenie ze ścianą
     if(dest_tile==TILE_WALL)
         return;
 
     // Aktualizacja pozycji
+    sd->beasts_count[sd_cell_index(sd, current_x, current_y)]--;
+    sd->beasts_count[sd_cell_index(sd, next_x, next_y)]++;
     beast->x = next_x;
     beast->y = next_y;
+    sd_redraw_tile(sd, current_x, current_y);
+    sd_redraw_tile(sd, next_x, next_y);
 
     // Wpadanie w krzaki
     if(dest_tile==TILE_BUSH && action!=ACTION_DO_NOTHING)
         beast->turns_to_wait = 1;
 
-    // Zderzenie z graczem
-    for(int i=0; i<MAX_CLIENTS_COUNT; i++)
-    {
-        struct server_client_data_t *client_data2 = sd->clients_data+i;
-        if(client_data2->type!=CLIENT_TYPE_FREE)
-        {
-            if(client_data2->current_x==beast->x && client_data2->current_y==beast->y)
-                sd_player_kill(sd, i);
-        }
-    }
+    // Zderzenie z graczem - tylko gracze stojący w komórce bestii
+    std::vector<int> &victims = sd->collision_victims;
+    sd_players_in_cell(sd, sd_cell_index(sd, beast->x, beast->y), -1, &victims);
+    for(int k=0; k<(int)victims.size(); k++)
+        sd_player_kill(sd, victims[k]);
 }
 
 // Wypełnienie bloku danych wysyłanego do klienta
 void sd_fill_output_block(struct server_data_t *sd, int slot, struct map_t *complete_map, struct client_output_block_t *output)
 {
-    struct server_client_data_t *data = sd->clients_data+slot;
+    struct server_client_data_t *data = &sd->clients_data[slot];
 
     output->x = data->current_x;
     output->y = data->current_y;
@@ -230,6 +328,8 @@ void sd_fill_output_block(struct server_data_t *sd, int slot, struct map_t *comp
 
     output->round = sd->round;
     output->server_pid = sd->server_pid;
+    output->input_ack = data->input_seq;
+    output->tick = sd->tick;
 
     sd_fill_surrounding_area(complete_map, data->current_x, data->current_y, &output->surrounding_area);
 }
@@ -237,79 +337,124 @@ void sd_fill_output_block(struct server_data_t *sd, int slot, struct map_t *comp
 // Wylosowanie pozycji spawnu gracza
 void sd_set_player_spawn(struct server_data_t *sd, int slot)
 {
-    struct server_client_data_t *client = sd->clients_data+slot;
+    struct server_client_data_t *client = &sd->clients_data[slot];
 
-    struct map_t complete_map;
-    sd_create_complete_map(sd, &complete_map);
+    // Gdy na mapie nie ma wolnego miejsca gracz pojawia się w obozie
+    int x = sd->map.campside_x;
+    int y = sd->map.campside_y;
+    map_random_free_position(&sd->free_cells, &sd->entities_rng, &x, &y);
 
-    int x = 0;
-    int y = 0;
-
-    do
-    {
-        x = rand()%MAP_WIDTH;
-        y = rand()%MAP_HEIGHT;
-    }while(map_get_tile(&complete_map, x, y)!=TILE_FLOOR);
+    int old_x = client->current_x;
+    int old_y = client->current_y;
 
     client->spawn_x = x;
     client->spawn_y = y;
-    client->current_x = x;
-    client->current_y = y;
+    sd_player_set_position(sd, slot, x, y);
+
+    sd_redraw_tile(sd, old_x, old_y);
+    sd_redraw_tile(sd, x, y);
+}
+
+// Wygenerowanie od zera rundy bez graczy - mapa, monety, skarby i bestie
+void sd_generate_round(struct server_data_t *round)
+{
+    round->dropped_data.clear();
+    round->items.assign(round->map.width*round->map.height, TILE_VOID);
+    round->items_count = 0;
+    round->beasts.clear();
+    round->beasts_count.assign(round->map.width*round->map.height, 0);
+
+    map_generate_everything(&round->map, &round->maze_rng);
+    sd_rebuild_complete_map(round);
+    sd_generate_entities(round);
+}
+
+// Wątek przygotowujący kolejną rundę
+static void *sd_next_round_thread(void *ptr)
+{
+    struct server_data_t *round = (struct server_data_t *)ptr;
+    long long start = stats_now_ns();
+    sd_generate_round(round);
+    round->generation_ns = stats_now_ns()-start;
+    return NULL;
+}
+
+// Rozpoczęcie przygotowywania kolejnej rundy w tle
+static void sd_prepare_next_round(struct server_data_t *sd)
+{
+    // Za pierwszym razem powstaje osobny zestaw danych rundy - rozmieszcza monety i bestie z własnego strumienia,
+    // niezależnego od rozstawiania graczy w bieżącej rundzie
+    if(sd->next_round==NULL)
+    {
+        sd->next_round = new server_data_t();
+        sd_init(sd->next_round, 0, sd->map.width, sd->map.height, sd->seed);
+        rng_seed_stream(&sd->next_round->entities_rng, sd->seed, RNG_STREAM_ROUND_ENTITIES);
+    }
+
+    int res = pthread_create(&sd->next_round_thread, NULL, sd_next_round_thread, sd->next_round);
+    check(res==0, "pthread_create error");
 }
 
-// Wygenerowanie kolejnej rundy
+// Przejście do kolejnej rundy - przygotowana w tle runda zamieniana jest z bieżącą, a na nowo rozstawiani są tylko gracze
 void sd_next_round(struct server_data_t *sd)
 {
-    sd->round++;
+    // Pierwsza runda nie miała kiedy zostać przygotowana
+    if(sd->next_round==NULL)
+        sd_prepare_next_round(sd);
+    pthread_join(sd->next_round_thread, NULL);
+
+    struct server_data_t *next = sd->next_round;
+    std::swap(sd->map, next->map);
+    std::swap(sd->complete_map, next->complete_map);
+    std::swap(sd->free_cells, next->free_cells);
+    std::swap(sd->items, next->items);
+    std::swap(sd->items_count, next->items_count);
+    std::swap(sd->beasts, next->beasts);
+    std::swap(sd->beasts_count, next->beasts_count);
+    std::swap(sd->generation_ns, next->generation_ns);
 
+    sd->round++;
     sd->dropped_data.clear();
-    sd->treasures_s_data.clear();
-    sd->treasures_l_data.clear();
-    sd->coins_data.clear();
-    sd->beasts.clear();
-
-    map_generate_everything(&sd->map);
-    sd_generate_entities(sd);
+    sd->players_field_valid = 0;
     sd_reset_all_players(sd);
+
+    sd_prepare_next_round(sd);
 }
 
 // Wygenerowanie monet, skarbów, bestii
 void sd_generate_entities(struct server_data_t *sd)
 {
-    int money_count = MAP_HEIGHT*MAP_WIDTH/MAP_GEN_COIN_FACTOR+1;
+    int money_count = sd->map.width*sd->map.height/MAP_GEN_COIN_FACTOR+1;
     for(int i=0; i<money_count; i++)
     {
         int x = 0;
         int y = 0;
-        int res = map_random_free_position(&sd->map, &x, &y);
+        int res = map_random_free_position(&sd->free_cells, &sd->entities_rng, &x, &y);
         if(res!=0) break;
-        struct server_something_data_t new_something = { x, y };
-        sd->coins_data.push_back(new_something);
+        sd_place_item(sd, x, y, TILE_COIN);
     }
 
-    int treasure_s_count = MAP_HEIGHT*MAP_WIDTH/MAP_GEN_TREASURE_S_FACTOR+1;
+    int treasure_s_count = sd->map.width*sd->map.height/MAP_GEN_TREASURE_S_FACTOR+1;
     for(int i=0; i<treasure_s_count; i++)
     {
         int x = 0;
         int y = 0;
-        int res = map_random_free_position(&sd->map, &x, &y);
+        int res = map_random_free_position(&sd->free_cells, &sd->entities_rng, &x, &y);
         if(res!=0) break;
-        struct server_something_data_t new_something = { x, y };
-        sd->treasures_s_data.push_back(new_something);
+        sd_place_item(sd, x, y, TILE_S_TREASURE);
     }
 
-    int treasure_l_count = MAP_HEIGHT*MAP_WIDTH/MAP_GEN_TREASURE_L_FACTOR+1;
+    int treasure_l_count = sd->map.width*sd->map.height/MAP_GEN_TREASURE_L_FACTOR+1;
     for(int i=0; i<treasure_l_count; i++)
     {
         int x = 0;
         int y = 0;
-        int res = map_random_free_position(&sd->map, &x, &y);
+        int res = map_random_free_position(&sd->free_cells, &sd->entities_rng, &x, &y);
         if(res!=0) break;
-        struct server_something_data_t new_something = { x, y };
-        sd->treasures_l_data.push_back(new_something);
+        sd_place_item(sd, x, y, TILE_L_TREASURE);
     }
 
-    int beasts_count = MAP_HEIGHT*MAP_WIDTH/MAP_GEN_BEAST_FACTOR+1;
+    int beasts_count = sd->map.width*sd->map.height/MAP_GEN_BEAST_FACTOR+1;
     for(int i=0; i<beasts_count; i++)
     {
         sd_add_beast(sd);
@@ -319,9 +464,10 @@ void sd_generate_entities(struct server_data_t *sd)
 // Zresetowanie wszystkich graczy
 void sd_reset_all_players(struct server_data_t *sd)
 {
-    for(int i=0; i<MAX_CLIENTS_COUNT; i++)
+    for(int k=0; k<(int)sd->active_slots.size(); k++)
     {
-        struct server_client_data_t *client = sd->clients_data+i;
+        int i = sd->active_slots[k];
+        struct server_client_data_t *client = &sd->clients_data[i];
         if(client->type!=CLIENT_TYPE_FREE)
         {
             sd_set_player_spawn(sd, i);
@@ -334,163 +480,307 @@ void sd_reset_all_players(struct server_data_t *sd)
     }
 }
 
-// Utworzenie pełnej mapy - uwzględniającej listy monet, skarbów, bestii...
-void sd_create_complete_map(struct server_data_t *sd, struct map_t *result_map)
+// Odbudowanie od zera pełnej mapy - uwzględniającej listy monet, skarbów, bestii...
+// Używane jedynie przy zmianie tła mapy, później mapa jest aktualizowana przez sd_redraw_tile
+void sd_rebuild_complete_map(struct server_data_t *sd)
 {
-    result_map->viewpoint_x = sd->map.viewpoint_x;
-    result_map->viewpoint_y = sd->map.viewpoint_y;
+    struct map_t *result_map = &sd->complete_map;
+    result_map->campside_x = sd->map.campside_x;
+    result_map->campside_y = sd->map.campside_y;
 
     // Odbijanie tła mapy
     map_copy(&sd->map, result_map);
 
     // Odbijanie graczy na mapie
-    for(int i=0; i<MAX_CLIENTS_COUNT; i++)
+    for(int k=0; k<(int)sd->active_slots.size(); k++)
     {
-        struct server_client_data_t *client = sd->clients_data+i;
+        int i = sd->active_slots[k];
+        struct server_client_data_t *client = &sd->clients_data[i];
         if(client->type!=CLIENT_TYPE_FREE)
-            result_map->map[client->current_y][client->current_x] = (enum tile_t)(TILE_PLAYER1+i);
+            map_set_tile(result_map, client->current_x, client->current_y, TILE_PLAYER);
     }
 
     // Odbijanie dropu
-    for(int i=0; i<(int)sd->dropped_data.size(); i++)
-    {
-        struct server_drop_data_t *drop = &(sd->dropped_data.at(i));
-        result_map->map[drop->y][drop->x] = TILE_DROP;
-    }
-
-    // Odbijanie monet
-    for(int i=0; i<(int)sd->coins_data.size(); i++)
-    {
-        struct server_something_data_t *sth = &(sd->coins_data.at(i));
-        result_map->map[sth->y][sth->x] = TILE_COIN;
-    }
+    for(std::unordered_map<int, int>::iterator drop=sd->dropped_data.begin(); drop!=sd->dropped_data.end(); drop++)
+        map_set_tile(result_map, drop->first%sd->map.width, drop->first/sd->map.width, TILE_DROP);
 
-    // Odbijanie małych skarbów
-    for(int i=0; i<(int)sd->treasures_s_data.size(); i++)
+    // Odbijanie monet i skarbów
+    for(int cell=0; cell<(int)sd->items.size(); cell++)
     {
-        struct server_something_data_t *sth = &(sd->treasures_s_data.at(i));
-        result_map->map[sth->y][sth->x] = TILE_S_TREASURE;
-    }
-
-    // Odbijanie dużych skarbów
-    for(int i=0; i<(int)sd->treasures_l_data.size(); i++)
-    {
-        struct server_something_data_t *sth = &(sd->treasures_l_data.at(i));
-        result_map->map[sth->y][sth->x] = TILE_L_TREASURE;
+        if(sd->items[cell]!=TILE_VOID)
+            map_set_tile(result_map, cell%sd->map.width, cell/sd->map.width, sd->items[cell]);
     }
 
     // Odbijanie bestii
     for(int i=0; i<(int)sd->beasts.size(); i++)
     {
         struct beast_t *beast = &(sd->beasts.at(i));
-        result_map->map[beast->y][beast->x] = TILE_BEAST;
+        map_set_tile(result_map, beast->x, beast->y, TILE_BEAST);
     }
 
     // Odbicie obozowiska
-    result_map->map[sd->map.campside_y][sd->map.campside_x] = TILE_CAMPSIDE;
+    map_set_tile(result_map, sd->map.campside_x, sd->map.campside_y, TILE_CAMPSIDE);
+
+    map_free_cells_build(&sd->free_cells, result_map);
+}
+
+// Odświeżenie jednego kafelka pełnej mapy - warstwy nakładane w tej samej kolejności co w sd_rebuild_complete_map
+void sd_redraw_tile(struct server_data_t *sd, int x, int y)
+{
+    if(x<0 || y<0 || x>=sd->map.width || y>=sd->map.height)
+        return;
+
+    // Tło mapy
+    enum tile_t tile = map_tile_at(&sd->map, x, y);
+
+    int cell = sd_cell_index(sd, x, y);
+
+    // Gracze
+    if(sd->players_first[cell]!=-1)
+        tile = TILE_PLAYER;
+
+    // Drop
+    if(sd->dropped_data.count(cell))
+        tile = TILE_DROP;
+
+    // Monety i skarby
+    if(sd->items[cell]!=TILE_VOID)
+        tile = sd->items[cell];
+
+    // Bestie
+    if(sd->beasts_count[cell]>0)
+        tile = TILE_BEAST;
+
+    // Obozowisko
+    if(x==sd->map.campside_x && y==sd->map.campside_y)
+        tile = TILE_CAMPSIDE;
+
+    if(map_tile_at(&sd->complete_map, x, y)!=tile)
+        sd->tile_changes[cell] = sd->tile_change_stamp;
+
+    map_set_tile(&sd->complete_map, x, y, tile);
+    map_free_cells_update(&sd->free_cells, x, y, tile);
 }
 
 // Zabicie gracza - upuszcza on drop
 void sd_player_kill(struct server_data_t *sd, int slot)
 {
-    struct server_client_data_t *client = sd->clients_data+slot;
+    struct server_client_data_t *client = &sd->clients_data[slot];
 
+    // Drop łączy się z leżącym już w tym miejscu
     if(client->coins_found>0)
-    {
-        int drop_found = 0;
-        for(int i=0; i<(int)sd->dropped_data.size(); i++)
-        {
-            struct server_drop_data_t *drop = &(sd->dropped_data.at(i));
-            if(drop->x==client->current_x && drop->y==client->current_y)
-            {
-                drop->value += client->coins_found;
-                drop_found = 1;
-                break;
-            }
-        }
+        sd->dropped_data[sd_cell_index(sd, client->current_x, client->current_y)] += client->coins_found;
 
-        if(!drop_found)
-        {
-            struct server_drop_data_t new_drop = { client->current_x, client->current_y, client->coins_found };
-            sd->dropped_data.push_back(new_drop);
-        }
-    }
+    // Gracz zmienia pozycję - pole odległości do przeliczenia
+    sd->players_field_valid = 0;
+
+    int old_x = client->current_x;
+    int old_y = client->current_y;
 
     client->deaths++;
-    client->current_x = client->spawn_x;
-    client->current_y = client->spawn_y;
+    sd_player_set_position(sd, slot, client->spawn_x, client->spawn_y);
     client->coins_found = 0;
+
+    sd_redraw_tile(sd, old_x, old_y);
+    sd_redraw_tile(sd, client->current_x, client->current_y);
 }
 
 // Wypełnienie bloku najbliższego sąsiedztwa gracza - wysyłanego klientowi
+// Gracz stoi zawsze na mapie, a obszar nie wychodzi poza ramkę, więc kafelki są czytane bez sprawdzania granic
 void sd_fill_surrounding_area(struct map_t *complete_map, int cx, int cy, surrounding_area_t *area)
 {
     for(int i=0; i<VISIBLE_AREA_SIZE; i++)
     {
         for(int j=0; j<VISIBLE_AREA_SIZE; j++)
-        {
-            int rel_y = i-VISIBLE_DISTANCE;
-            int rel_x = j-VISIBLE_DISTANCE;
-
-            enum tile_t tile = map_get_tile(complete_map, cx+rel_x, cy+rel_y);
-            (*area)[i][j] = tile;
-        }
+            (*area)[i][j] = map_tile_at(complete_map, cx+j-VISIBLE_DISTANCE, cy+i-VISIBLE_DISTANCE);
     }
 }
 
 // Dodanie monety/skarbu
 void sd_add_something(struct server_data_t *sd, enum tile_t tile)
 {
-    struct map_t complete_map;
-    sd_create_complete_map(sd, &complete_map);
-
     int x = 0;
     int y = 0;
 
-    int res = map_random_free_position(&complete_map, &x, &y);      
+    int res = map_random_free_position(&sd->free_cells, &sd->entities_rng, &x, &y);      
     if(res==1) return;
 
-    struct server_something_data_t new_something = { x, y };
-
-    if(tile==TILE_COIN)
-        sd->coins_data.push_back(new_something);
-    else if(tile==TILE_S_TREASURE)
-        sd->treasures_s_data.push_back(new_something);
-    else if(tile==TILE_L_TREASURE)
-        sd->treasures_l_data.push_back(new_something);
+    if(tile==TILE_COIN || tile==TILE_S_TREASURE || tile==TILE_L_TREASURE)
+        sd_place_item(sd, x, y, tile);
 }
 
 // Dodanie bestii
 void sd_add_beast(struct server_data_t *sd)
 {
-    struct map_t complete_map;
-    sd_create_complete_map(sd, &complete_map);
-
     int x = 0;
     int y = 0;
 
-    do
-    {
-        x = rand()%MAP_WIDTH;
-        y = rand()%MAP_HEIGHT;
-    }while(map_get_tile(&complete_map, x, y)!=TILE_FLOOR);
+    int res = map_random_free_position(&sd->free_cells, &sd->entities_rng, &x, &y);
+    if(res==1) return;
 
     struct beast_t beast;
-    beast_init(&beast, x, y);
+    beast_init(&beast, x, y, &sd->entities_rng);
     sd->beasts.push_back(beast);
+    sd->beasts_count[sd_cell_index(sd, x, y)]++;
+    sd_redraw_tile(sd, x, y);
+}
+
+// Podjęcie decyzji dla przedziału bestii na podstawie migawki z początku ruchu bestii - wywoływane z puli wątków
+static void sd_decide_beasts_task(void *arg, int begin, int end)
+{
+    struct server_data_t *sd = (struct server_data_t *)arg;
+    for(int i=begin; i<end; i++)
+        beast_decide(sd, &sd->beasts[i], sd->beast_randoms[i], &sd->beast_decisions[i]);
+}
+
+// Czy od migawki zmienił się któryś kafelek, od którego zależy decyzja bestii
+static int sd_beast_surrounding_changed(struct server_data_t *sd, struct beast_t *beast)
+{
+    for(int y=beast->y-SD_BEAST_DECISION_RADIUS; y<=beast->y+SD_BEAST_DECISION_RADIUS; y++)
+    {
+        for(int x=beast->x-SD_BEAST_DECISION_RADIUS; x<=beast->x+SD_BEAST_DECISION_RADIUS; x++)
+        {
+            if(x<0 || y<0 || x>=sd->map.width || y>=sd->map.height)
+                continue;
+            if(sd->tile_changes[sd_cell_index(sd, x, y)]==sd->tile_change_stamp)
+                return 1;
+        }
+    }
+    return 0;
 }
 
 // Aktualizacja wszystkich bestii
+// Decyzje podejmowane są równolegle na migawce, a ruchy wykonywane po kolei - decyzja, której dane wejściowe zmieniły
+// wcześniejsze ruchy, jest podejmowana ponownie, więc wynik jest taki sam jak przy podejmowaniu decyzji jedna po drugiej
 void sd_update_beasts(struct server_data_t *sd)
 {
-    for(int i=0; i<(int)sd->beasts.size(); i++)
-        beast_update(sd, i);
+    int count = sd->beasts.size();
+
+    // Pole odległości zawsze liczone od nowa na początku ruchu bestii - później tylko po zabiciu gracza
+    sd_update_players_field(sd, &sd->complete_map);
+
+    sd->beast_randoms.resize(count);
+    sd->beast_decisions.resize(count);
+
+    // Losowania każdej bestii pobierane po kolei ze strumienia bestii jeszcze przed podziałem na wątki,
+    // więc wątki nie losują same i wynik nie zależy od ich liczby
+    for(int i=0; i<count; i++)
+        sd->beast_randoms[i] = (unsigned)(rng_next(&sd->beasts_rng)>>32);
+
+    // Od tej chwili każda zmiana pełnej mapy jest oznaczana nowym znacznikiem
+    sd->tile_change_stamp++;
+
+    int precomputed = sd->pool!=NULL && pool_threads_count(sd->pool)>1 && count>=SD_PARALLEL_BEASTS_MIN;
+    if(precomputed)
+        pool_run(sd->pool, count, sd_decide_beasts_task, sd);
+
+    for(int i=0; i<count; i++)
+    {
+        struct beast_t *beast = &sd->beasts[i];
+        struct beast_decision_t *decision = &sd->beast_decisions[i];
+
+        int stale = !precomputed || sd_beast_surrounding_changed(sd, beast);
+        if(decision->attack && (!sd->players_field_valid || decision->field_version!=sd->players_field_version))
+            stale = 1;
+
+        if(stale)
+        {
+            // Po zabiciu gracza pole jest przeliczane dopiero, gdy któraś bestia go potrzebuje
+            if(!sd->players_field_valid && beast_see_player(beast, &sd->complete_map))
+                sd_update_players_field(sd, &sd->complete_map);
+            beast_decide(sd, beast, sd->beast_randoms[i], decision);
+        }
+
+        beast_apply(sd, beast, decision);
+    }
 }
 
 // Sprawdzenie czy monety i skarby zostały pozbierane i nowa runda może być generowana
 int sd_is_everything_colected(struct server_data_t *sd)
 {
-    if(sd->treasures_s_data.empty() && sd->treasures_l_data.empty() && sd->coins_data.empty() && sd->dropped_data.empty()) 
+    if(sd->items_count==0 && sd->dropped_data.empty()) 
         return 1;
     return 0;
 }
+
+// Dołączenie kolejnej wartości do sumy kontrolnej - FNV-1a na całych słowach
+static inline uint64_t sd_hash_mix(uint64_t hash, uint64_t value)
+{
+    return (hash^value)*0x100000001b3ULL;
+}
+
+// Suma kontrolna stanu gry - tura, runda, gracze, bestie i przedmioty; pozwala wykryć chwilę rozejścia się dwóch przebiegów
+// Przedmioty i dropy wchodzą do sumy razem z komórkami i wartościami, dropy w kolejności komórek, bo kolejność w tablicy haszującej nie jest ustalona
+uint64_t sd_state_hash(struct server_data_t *sd)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = sd_hash_mix(hash, sd->tick);
+    hash = sd_hash_mix(hash, sd->round);
+
+    hash = sd_hash_mix(hash, sd->items_count);
+    for(int cell=0; cell<(int)sd->items.size(); cell++)
+    {
+        if(sd->items[cell]!=TILE_VOID)
+        {
+            hash = sd_hash_mix(hash, cell);
+            hash = sd_hash_mix(hash, sd->items[cell]);
+        }
+    }
+
+    std::vector<std::pair<int, int> > drops(sd->dropped_data.begin(), sd->dropped_data.end());
+    std::sort(drops.begin(), drops.end());
+    hash = sd_hash_mix(hash, drops.size());
+    for(int k=0; k<(int)drops.size(); k++)
+    {
+        hash = sd_hash_mix(hash, drops[k].first);
+        hash = sd_hash_mix(hash, drops[k].second);
+    }
+
+    for(int k=0; k<(int)sd->active_slots.size(); k++)
+    {
+        int i = sd->active_slots[k];
+        struct server_client_data_t *client = &sd->clients_data[i];
+        hash = sd_hash_mix(hash, i);
+        hash = sd_hash_mix(hash, client->current_y*sd->map.width+client->current_x);
+        hash = sd_hash_mix(hash, client->coins_found);
+        hash = sd_hash_mix(hash, client->coins_brought);
+        hash = sd_hash_mix(hash, client->deaths);
+        hash = sd_hash_mix(hash, client->turns_to_wait);
+    }
+
+    for(int i=0; i<(int)sd->beasts.size(); i++)
+    {
+        struct beast_t *beast = &sd->beasts[i];
+        hash = sd_hash_mix(hash, beast->y*sd->map.width+beast->x);
+        hash = sd_hash_mix(hash, beast->turns_to_wait);
+        hash = sd_hash_mix(hash, beast->current_direction);
+        hash = sd_hash_mix(hash, beast->turns_to_stay);
+    }
+
+    return hash;
+}
+
+// Przeliczenie pola odległości od wszystkich graczy na podstawie pełnej mapy
+void sd_update_players_field(struct server_data_t *sd, struct map_t *complete_map)
+{
+    int count = sd->active_slots.size();
+    std::vector<int> sources_x(count);
+    std::vector<int> sources_y(count);
+    int sources_count = 0;
+
+    for(int k=0; k<(int)sd->active_slots.size(); k++)
+    {
+        int i = sd->active_slots[k];
+        struct server_client_data_t *client = &sd->clients_data[i];
+        if(client->type!=CLIENT_TYPE_FREE)
+        {
+            sources_x[sources_count] = client->current_x;
+            sources_y[sources_count] = client->current_y;
+            sources_count++;
+        }
+    }
+
+    indep_distance_field_build(&sd->players_field, complete_map, sources_x.data(), sources_y.data(), sources_count, BEAST_ATTACK_DISTANCE);
+    sd->players_field_valid = 1;
+    sd->players_field_version++;
+}
\ No newline at end of file
@@ -3,13 +3,26 @@
 
 #include <stdint.h>
 #include <vector>
+#include <unordered_map>
 #include <pthread.h>
 #include "server_data.h"
 #include "common.h"
 #include "map.h"
 #include "beast.h"
+#include "independant.h"
+#include "pool.h"
+#include "rng.h"
 #include "tiles.h"
 
+// Od jakiej liczby bestii decyzje są podejmowane równolegle w puli wątków
+#define SD_PARALLEL_BEASTS_MIN 256
+
+// Promień otoczenia, od którego zależy decyzja bestii - zasięg wzroku
+#define SD_BEAST_DECISION_RADIUS 2
+
+// Okno wzroku bestii czytane jest bez sprawdzania granic
+static_assert(SD_BEAST_DECISION_RADIUS<=MAP_BORDER, "beast sight window must fit in the map border");
+
 // Dane klienta po stronie serwera
 struct server_client_data_t
 {
@@ -28,21 +41,9 @@ struct server_client_data_t
     int deaths;
 
     int turns_to_wait;
-};
 
-// Dane dropu
-struct server_drop_data_t
-{
-    int x;
-    int y;
-    int value;
-};
-
-// Dane monety/skarbu
-struct server_something_data_t
-{
-    int x;
-    int y;
+    // Numer ostatniej wykonanej akcji z kolejki klienta
+    uint32_t input_seq;
 };
 
 // Wszystkie dane serwera
@@ -51,37 +52,102 @@ struct server_data_t
     int server_pid;
     int round;
 
+    // Numer bieżącej tury
+    uint32_t tick;
+
+    // Tło mapy - ściany, korytarze, krzaki
     struct map_t map;
 
+    // Pełna mapa - tło z naniesionymi graczami, monetami, skarbami i bestiami
+    // Utrzymywana na bieżąco przez sd_redraw_tile i współdzielona przez wszystkich czytelników
+    struct map_t complete_map;
+
+    // Wolne kafelki pełnej mapy - miejsca do losowania pozycji nowych graczy, bestii, monet...
+    struct map_free_cells_t free_cells;
+
+    // Ziarno rozgrywki i wyprowadzone z niego strumienie - labirynt, rozmieszczanie graczy, monet i bestii, ruchy bestii
+    uint64_t seed;
+    struct rng_t maze_rng;
+    struct rng_t entities_rng;
+    struct rng_t beasts_rng;
+
+    // Kolejna runda przygotowywana w tle przez osobny wątek - używane są tylko jej pola opisujące rundę,
+    // a jej generator daje ciąg rund niezależny od tego, co dzieje się w grze
+    struct server_data_t *next_round;
+    pthread_t next_round_thread;
+
+    // Czas generowania bieżącej rundy w nanosekundach
+    long long generation_ns;
+
     // Mamy jedynie dwa wątki update i input
     pthread_mutex_t update_vs_input_mutex;
     
-    std::vector<struct server_drop_data_t> dropped_data;
-    std::vector<struct server_something_data_t> treasures_s_data;
-    std::vector<struct server_something_data_t> treasures_l_data;
-    std::vector<struct server_something_data_t> coins_data;
+    // Indeks przestrzenny - komórki numerowane y*width+x
+    // Dropy: komórka -> wartość, kilka dropów w jednym miejscu łączy się w jeden
+    std::unordered_map<int, int> dropped_data;
+
+    // Moneta/skarb leżący w komórce (lub TILE_VOID) i liczba wszystkich leżących
+    std::vector<enum tile_t> items;
+    int items_count;
+
+    // Bestie i liczba bestii stojących w komórce - bestie nie blokują się nawzajem, a administrator może dodawać je bez limitu,
+    // więc licznik musi pomieścić wszystkie bestie w jednej komórce
     std::vector<struct beast_t> beasts;
+    std::vector<int> beasts_count;
+
+    // Pole odległości od wszystkich graczy - liczone na początku ruchu bestii i po każdym zabiciu gracza, wspólne dla wszystkich bestii
+    struct indep_distance_field_t players_field;
+    int players_field_valid;
+    unsigned players_field_version;
+
+    // Znacznik ostatniej zmiany każdego kafelka pełnej mapy - pozwala sprawdzić, czy otoczenie bestii zmieniło się od migawki
+    std::vector<uint32_t> tile_changes;
+    uint32_t tile_change_stamp;
+
+    // Decyzje bestii w bieżącej turze i wylosowane dla nich liczby - losowane po kolei, niezależnie od liczby wątków
+    std::vector<struct beast_decision_t> beast_decisions;
+    std::vector<unsigned> beast_randoms;
+
+    // Pula wątków do podejmowania decyzji bestii - NULL oznacza podejmowanie ich po kolei
+    struct worker_pool_t *pool;
+
+    // Gracze stojący w komórce - dwukierunkowa lista slotów z początkiem w players_first (-1 gdy pusta)
+    // Dla każdego slotu komórka, w której jest zapisany na liście (-1 gdy nie ma go na mapie)
+    std::vector<int> players_first;
+    std::vector<int> players_next;
+    std::vector<int> players_prev;
+    std::vector<int> players_cell;
+
+    // Bufor na graczy zabijanych w jednym zderzeniu
+    std::vector<int> collision_victims;
 
-    struct server_client_data_t clients_data[MAX_CLIENTS_COUNT];
+    // Dane wszystkich slotów i lista zajętych slotów - pętle po graczach przechodzą tylko po zajętych
+    std::vector<struct server_client_data_t> clients_data;
+    std::vector<int> active_slots;
+    std::vector<int> active_positions;
 };
 
 // Prototypy
-void sd_init(struct server_data_t *data);
+void sd_init(struct server_data_t *data, int capacity, int map_width, int map_height, uint64_t seed);
 void sd_add_client(struct server_data_t *data, int slot, int pid, enum client_type_t type);
 void sd_remove_client(struct server_data_t *data, int slot);
 void sd_move(struct server_data_t *data, int slot, enum action_t action);
 void sd_fill_output_block(struct server_data_t *sd, int slot, struct map_t *complete_map, struct client_output_block_t *output);
 void sd_set_player_spawn(struct server_data_t *sd, int slot);
 void sd_next_round(struct server_data_t *sd);
-void sd_create_complete_map(struct server_data_t *sd, struct map_t *result_map);
+void sd_generate_round(struct server_data_t *round);
+void sd_rebuild_complete_map(struct server_data_t *sd);
+void sd_redraw_tile(struct server_data_t *sd, int x, int y);
 void sd_player_kill(struct server_data_t *sd, int slot);
 void sd_fill_surrounding_area(struct map_t *complete_map, int cx, int cy, surrounding_area_t *area);
 void sd_add_something(struct server_data_t *sd, enum tile_t tile);
 void sd_add_beast(struct server_data_t *sd);
 void sd_move_beast(struct server_data_t *sd, struct beast_t *beast, enum action_t action);
 void sd_update_beasts(struct server_data_t *sd);
+void sd_update_players_field(struct server_data_t *sd, struct map_t *complete_map);
 void sd_generate_entities(struct server_data_t *sd);
 void sd_reset_all_players(struct server_data_t *sd);
 int sd_is_everything_colected(struct server_data_t *sd);
+uint64_t sd_state_hash(struct server_data_t *sd);
 
 #endif
\ No newline at end of file
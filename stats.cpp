@@ -0,0 +1,131 @@
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+// Nazwy etapów i liczników - w kolejności typów wyliczeniowych
+const char *stats_phase_names[STATS_PHASES_COUNT] =
+{
+    "tick", "input", "beasts", "output", "round_switch", "round_generation", "snapshot", "render"
+};
+
+const char *stats_counter_names[STATS_COUNTERS_COUNT] =
+{
+    "evictions", "lock_repairs", "round_switches"
+};
+
+// Funkcje statyczne
+static int stats_bucket_index(long long ns);
+static long long stats_bucket_upper_bound(int index);
+
+// Aktualny czas w nanosekundach
+long long stats_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec*1000000000LL+now.tv_nsec;
+}
+
+// Numer przedziału dla danego czasu - najstarszy bit wyznacza potęgę dwójki, kolejne bity przedział w jej obrębie
+static int stats_bucket_index(long long ns)
+{
+    if(ns<STATS_SUB_BUCKETS)
+        return ns<0 ? 0 : (int)ns;
+
+    int exponent = 63-__builtin_clzll(ns);
+    int sub = (ns>>(exponent-STATS_SUB_BUCKETS_SHIFT)) & (STATS_SUB_BUCKETS-1);
+    int index = (exponent-STATS_SUB_BUCKETS_SHIFT+1)*STATS_SUB_BUCKETS+sub;
+    return index<STATS_BUCKETS ? index : STATS_BUCKETS-1;
+}
+
+// Największa wartość należąca do przedziału
+static long long stats_bucket_upper_bound(int index)
+{
+    if(index<STATS_SUB_BUCKETS)
+        return index;
+
+    int exponent = index/STATS_SUB_BUCKETS+STATS_SUB_BUCKETS_SHIFT-1;
+    long long sub = index%STATS_SUB_BUCKETS;
+    return ((STATS_SUB_BUCKETS+sub+1)<<(exponent-STATS_SUB_BUCKETS_SHIFT))-1;
+}
+
+// Dodanie pomiaru do histogramu
+void stats_histogram_record(struct stats_histogram_t *histogram, long long ns)
+{
+    if(ns<0)
+        ns = 0;
+    histogram->buckets[stats_bucket_index(ns)]++;
+    histogram->count++;
+    histogram->sum_ns += ns;
+    if((uint64_t)ns>histogram->max_ns)
+        histogram->max_ns = ns;
+}
+
+// Wartość, której nie przekracza podana część pomiarów - górna granica przedziału, nie większa od maksimum
+long long stats_histogram_percentile(struct stats_histogram_t *histogram, double percentile)
+{
+    if(histogram->count==0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(percentile*histogram->count);
+    if(rank>=histogram->count)
+        rank = histogram->count-1;
+
+    uint64_t seen = 0;
+    for(int i=0; i<STATS_BUCKETS; i++)
+    {
+        seen += histogram->buckets[i];
+        if(seen>rank)
+        {
+            long long bound = stats_bucket_upper_bound(i);
+            return (uint64_t)bound<histogram->max_ns ? bound : (long long)histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+// Pomiary dodane między dwoma odczytami histogramu - maksimum nie da się odjąć, więc zostaje maksimum całkowite
+void stats_histogram_subtract(struct stats_histogram_t *result, struct stats_histogram_t *current, struct stats_histogram_t *previous)
+{
+    for(int i=0; i<STATS_BUCKETS; i++)
+        result->buckets[i] = current->buckets[i]-previous->buckets[i];
+    result->count = current->count-previous->count;
+    result->sum_ns = current->sum_ns-previous->sum_ns;
+    result->max_ns = current->max_ns;
+}
+
+// Początek zapisu bloku - sequence staje się nieparzysty
+void stats_write_begin(struct stats_block_t *block)
+{
+    __atomic_store_n(&block->sequence, block->sequence+1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// Koniec zapisu bloku - sequence znów parzysty
+void stats_write_end(struct stats_block_t *block)
+{
+    __atomic_store_n(&block->sequence, block->sequence+1, __ATOMIC_RELEASE);
+}
+
+// Spójna kopia bloku - odczyt powtarzany, dopóki serwer zapisywał blok w trakcie kopiowania
+// Liczba prób jest ograniczona, bo serwer zabity w trakcie zapisu zostawia nieparzysty sequence na zawsze - 0 gdy kopii nie udało się wykonać
+int stats_read(struct stats_block_t *block, struct stats_block_t *copy)
+{
+    struct timespec pause = { 0, STATS_READ_PAUSE_NS };
+    for(int attempt=0; attempt<STATS_READ_ATTEMPTS; attempt++)
+    {
+        if(attempt>0)
+            nanosleep(&pause, NULL);
+
+        uint32_t before = __atomic_load_n(&block->sequence, __ATOMIC_ACQUIRE);
+        if(before%2==1)
+            continue;
+
+        memcpy(copy, block, sizeof(*copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if(__atomic_load_n(&block->sequence, __ATOMIC_RELAXED)==before)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+
+// Pamięć współdzielona ze statystykami serwera - osobny blok, który czytelnicy mapują tylko do odczytu
+#define STATS_SHM_FILE_NAME "game_stats_shm"
+#define STATS_VERSION 1
+
+// Przedziały histogramu - wartości do 8 ns dokładnie, dalej 8 przedziałów na każdą potęgę dwójki (błąd do 12.5%)
+#define STATS_SUB_BUCKETS_SHIFT 3
+#define STATS_SUB_BUCKETS (1<<STATS_SUB_BUCKETS_SHIFT)
+#define STATS_BUCKETS 320
+
+// Odczyt bloku - najwyżej tyle prób z przerwą między nimi, razem około 0.1 s, znacznie dłużej niż trwa jedna publikacja
+#define STATS_READ_ATTEMPTS 1000
+#define STATS_READ_PAUSE_NS 100000
+
+// Mierzone etapy pracy serwera
+enum stats_phase_t
+{
+    // Cała tura wykonywana pod blokadą danych serwera
+    STATS_PHASE_TICK,
+
+    // Wykrywanie martwych klientów, dołączanie, usuwanie i odczyt akcji
+    STATS_PHASE_INPUT,
+
+    // Ruch bestii
+    STATS_PHASE_BEASTS,
+
+    // Wypełnianie i publikowanie bloków wyjściowych klientów
+    STATS_PHASE_OUTPUT,
+
+    // Zmiana rundy w turze - oczekiwanie na rundę generowaną w tle i rozstawienie graczy
+    STATS_PHASE_ROUND_SWITCH,
+
+    // Generowanie rundy w tle - labirynt, pełna mapa, monety i bestie
+    STATS_PHASE_ROUND_GENERATION,
+
+    // Przygotowanie migawki dla wątku wyświetlającego
+    STATS_PHASE_SNAPSHOT,
+
+    // Rysowanie migawki przez wątek wyświetlający
+    STATS_PHASE_RENDER,
+
+    STATS_PHASES_COUNT
+};
+
+// Liczniki zdarzeń
+enum stats_counter_t
+{
+    // Klienci usunięci przez serwer - martwi lub nieodpowiadający
+    STATS_COUNTER_EVICTIONS,
+
+    // Sekcje krytyczne naprawiane przez enter_cs po śmierci właściciela
+    STATS_COUNTER_LOCK_REPAIRS,
+
+    // Zmiany rundy
+    STATS_COUNTER_ROUND_SWITCHES,
+
+    STATS_COUNTERS_COUNT
+};
+
+// Histogram czasów w nanosekundach
+struct stats_histogram_t
+{
+    uint64_t buckets[STATS_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+};
+
+// Blok statystyk w pamięci współdzielonej - zapisywany tylko przez serwer
+// Nieparzysty sequence oznacza zapis w toku, czytelnik kopiuje blok i powtarza odczyt, gdy sequence się zmienił
+struct stats_block_t
+{
+    uint32_t sequence;
+    uint32_t version;
+    int server_pid;
+
+    // Stan gry w chwili ostatniej publikacji
+    uint32_t tick;
+    int round;
+    int players;
+    int beasts;
+    long long overruns;
+
+    uint64_t counters[STATS_COUNTERS_COUNT];
+    struct stats_histogram_t phases[STATS_PHASES_COUNT];
+};
+
+// Nazwy etapów i liczników do wyświetlania
+extern const char *stats_phase_names[STATS_PHASES_COUNT];
+extern const char *stats_counter_names[STATS_COUNTERS_COUNT];
+
+// Prototypy
+long long stats_now_ns(void);
+void stats_histogram_record(struct stats_histogram_t *histogram, long long ns);
+long long stats_histogram_percentile(struct stats_histogram_t *histogram, double percentile);
+void stats_histogram_subtract(struct stats_histogram_t *result, struct stats_histogram_t *current, struct stats_histogram_t *previous);
+void stats_write_begin(struct stats_block_t *block);
+void stats_write_end(struct stats_block_t *block);
+int stats_read(struct stats_block_t *block, struct stats_block_t *copy);
+
+#endif
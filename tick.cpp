@@ -0,0 +1,90 @@
+#include <time.h>
+#include <errno.h>
+#include "tick.h"
+
+// Funkcje statyczne
+static void tick_add_ns(struct timespec *time, long long ns);
+static long long tick_diff_ns(const struct timespec *a, const struct timespec *b);
+
+// Przesunięcie czasu o podaną liczbę nanosekund
+static void tick_add_ns(struct timespec *time, long long ns)
+{
+    long long total = time->tv_nsec + ns;
+    time->tv_sec += total / 1000000000;
+    time->tv_nsec = total % 1000000000;
+}
+
+// Różnica a-b w nanosekundach
+static long long tick_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+    return (long long)(a->tv_sec - b->tv_sec) * 1000000000 + (a->tv_nsec - b->tv_nsec);
+}
+
+// Inicjacja harmonogramu - pierwsza tura kończy się period_ns od teraz
+void tick_init(struct tick_scheduler_t *tick, long period_ns, enum tick_overrun_policy_t policy)
+{
+    tick->period_ns = period_ns;
+    tick->policy = policy;
+
+    tick->ticks = 0;
+    tick->overruns = 0;
+    tick->skipped = 0;
+    tick->last_jitter_ns = 0;
+    tick->max_jitter_ns = 0;
+    tick->jitter_sum_ns = 0;
+    tick->jitter_samples = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &tick->next_deadline);
+    tick_add_ns(&tick->next_deadline, period_ns);
+}
+
+// Czeka na początek kolejnej tury - wywoływane po zakończeniu pracy w bieżącej turze
+void tick_wait(struct tick_scheduler_t *tick)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    tick->ticks++;
+
+    long long late_ns = tick_diff_ns(&now, &tick->next_deadline);
+
+    // Praca w turze trwała dłużej niż okres
+    if(late_ns>=0)
+    {
+        tick->overruns++;
+        long long missed = late_ns / tick->period_ns;
+
+        // Nadrabianie - bez czekania, termin przesuwa się tylko o jeden okres
+        if(tick->policy==TICK_OVERRUN_CATCH_UP && missed<TICK_CATCH_UP_MAX)
+        {
+            tick->last_jitter_ns = 0;
+            tick_add_ns(&tick->next_deadline, tick->period_ns);
+            return;
+        }
+
+        // Pomijanie - termin przeskakuje na najbliższy przyszły punkt siatki
+        tick->skipped += missed+1;
+        tick_add_ns(&tick->next_deadline, (missed+1)*tick->period_ns);
+    }
+
+    // Sen do bezwzględnego terminu - przerwany sygnałem jest wznawiany
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tick->next_deadline, NULL)==EINTR);
+
+    // Opóźnienie obudzenia względem terminu
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long jitter = tick_diff_ns(&now, &tick->next_deadline);
+    tick->last_jitter_ns = jitter;
+    tick->jitter_sum_ns += jitter;
+    tick->jitter_samples++;
+    if(jitter>tick->max_jitter_ns)
+        tick->max_jitter_ns = jitter;
+
+    tick_add_ns(&tick->next_deadline, tick->period_ns);
+}
+
+// Średnie opóźnienie obudzenia - tylko z tur, po których serwer faktycznie spał
+long tick_average_jitter_ns(struct tick_scheduler_t *tick)
+{
+    if(tick->jitter_samples==0)
+        return 0;
+    return tick->jitter_sum_ns / tick->jitter_samples;
+}
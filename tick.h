@@ -0,0 +1,43 @@
+#ifndef __TICK_H__
+#define __TICK_H__
+
+#include <time.h>
+
+// Maksymalna liczba zaległych tur nadrabianych w trybie TICK_OVERRUN_CATCH_UP - przy większym opóźnieniu tury są pomijane
+#define TICK_CATCH_UP_MAX 5
+
+// Zachowanie po przekroczeniu czasu tury
+enum tick_overrun_policy_t
+{
+    // Zaległe tury są pomijane, kolejna zaczyna się w najbliższym terminie z siatki
+    TICK_OVERRUN_SKIP,
+
+    // Zaległe tury wykonywane są od razu jedna po drugiej, aż do dogonienia siatki terminów
+    TICK_OVERRUN_CATCH_UP
+};
+
+// Harmonogram tur - budzenie w bezwzględnych terminach, bez kumulowania się opóźnień
+struct tick_scheduler_t
+{
+    long period_ns;
+    enum tick_overrun_policy_t policy;
+    struct timespec next_deadline;
+
+    // Statystyki
+    long long ticks;
+    long long overruns;
+    long long skipped;
+    long last_jitter_ns;
+    long max_jitter_ns;
+    long long jitter_sum_ns;
+
+    // Liczba pomiarów opóźnienia - tury nadrabiane bez snu nie mają pomiaru
+    long long jitter_samples;
+};
+
+// Prototypy
+void tick_init(struct tick_scheduler_t *tick, long period_ns, enum tick_overrun_policy_t policy);
+void tick_wait(struct tick_scheduler_t *tick);
+long tick_average_jitter_ns(struct tick_scheduler_t *tick);
+
+#endif
@@ -1,10 +1,10 @@
 #ifndef __TILES_H__
 #define __TILES_H__
 
-#include <ncursesw/ncurses.h>
+#include <stdint.h>
 
-// Kafelki z których składa się mapa
-enum tile_t
+// Kafelki z których składa się mapa - przechowywane na jednym bajcie
+enum tile_t : uint8_t
 {
     TILE_VOID       = 0,
     TILE_WALL       = 1,
@@ -18,16 +18,67 @@ enum tile_t
     TILE_DROP       = 9,
     TILE_UNKNOWN    = 10,
 
-    TILE_PLAYER1    = 11,
-    TILE_PLAYER2    = 12,
-    TILE_PLAYER3    = 13,
-    TILE_PLAYER4    = 14
+    // Dowolny gracz - który to gracz wynika z pozycji graczy, a nie z kafelka
+    TILE_PLAYER     = 11
 };
 
-int tile_is_sure(tile_t tile);
-int tile_is_walkable(tile_t tile);
-int tile_is_player(tile_t tile);
-const chtype tile_get_appearance(enum tile_t tile);
-void display_help_window(WINDOW *window);
+static_assert(sizeof(enum tile_t)==1, "tile_t must fit in one byte");
 
-#endif
\ No newline at end of file
+// Bity właściwości kafelków
+#define TILE_PROPERTY_SURE      0x01
+#define TILE_PROPERTY_WALKABLE  0x02
+#define TILE_PROPERTY_PLAYER    0x04
+
+// Właściwości pojedynczego kafelka - pewny to taki, który po zniknięciu z pola widzenia nie znika
+constexpr uint8_t tile_properties_of(int tile)
+{
+    return tile==TILE_WALL       ? TILE_PROPERTY_SURE :
+           tile==TILE_FLOOR      ? TILE_PROPERTY_SURE | TILE_PROPERTY_WALKABLE :
+           tile==TILE_CAMPSIDE   ? TILE_PROPERTY_SURE | TILE_PROPERTY_WALKABLE :
+           tile==TILE_BUSH       ? TILE_PROPERTY_SURE | TILE_PROPERTY_WALKABLE :
+           tile==TILE_DROP       ? TILE_PROPERTY_SURE | TILE_PROPERTY_WALKABLE :
+           tile==TILE_UNKNOWN    ? TILE_PROPERTY_SURE | TILE_PROPERTY_WALKABLE :
+           tile==TILE_COIN       ? TILE_PROPERTY_WALKABLE :
+           tile==TILE_S_TREASURE ? TILE_PROPERTY_WALKABLE :
+           tile==TILE_L_TREASURE ? TILE_PROPERTY_WALKABLE :
+           tile==TILE_PLAYER     ? TILE_PROPERTY_WALKABLE | TILE_PROPERTY_PLAYER :
+           0;
+}
+
+// Tablica właściwości dla wszystkich wartości bajtu - także tych spoza typu, które nie mają żadnej właściwości
+struct tile_properties_t
+{
+    uint8_t flags[256];
+};
+
+constexpr struct tile_properties_t tile_properties_build(void)
+{
+    struct tile_properties_t table = {};
+    for(int i=0; i<256; i++)
+        table.flags[i] = tile_properties_of(i);
+    return table;
+}
+
+inline constexpr struct tile_properties_t tile_properties = tile_properties_build();
+
+static_assert(tile_properties.flags[TILE_PLAYER]==(TILE_PROPERTY_WALKABLE | TILE_PROPERTY_PLAYER), "tile property table is broken");
+
+// Czy kafelek jest pewny
+inline int tile_is_sure(enum tile_t tile)
+{
+    return tile_properties.flags[tile] & TILE_PROPERTY_SURE;
+}
+
+// Czy po kafelku można chodzić
+inline int tile_is_walkable(enum tile_t tile)
+{
+    return (tile_properties.flags[tile] & TILE_PROPERTY_WALKABLE)>>1;
+}
+
+// Czy kafelek jest graczem
+inline int tile_is_player(enum tile_t tile)
+{
+    return (tile_properties.flags[tile] & TILE_PROPERTY_PLAYER)>>2;
+}
+
+#endif